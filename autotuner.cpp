@@ -0,0 +1,143 @@
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include "autotuner.h"
+
+Autotuner::Autotuner(const char *file_name) : file_name(file_name)
+{
+}
+
+std::string Autotuner::cpu_model()
+{
+	std::string model = "unknown";
+	FILE *in = fopen("/proc/cpuinfo", "rt");
+	if (in == NULL)
+		return model;
+	char line[512];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		if (strncmp(line, "model name", 10) != 0)
+			continue;
+		const char *value = strchr(line, ':');
+		if (value == NULL)
+			break;
+		model = value + 1 + strspn(value + 1, " ");
+		model.erase(model.find_last_not_of(" \n") + 1);
+		break;
+	}
+	fclose(in);
+	/* tabs separate fields of the tuning file */
+	std::replace(model.begin(), model.end(), '\t', ' ');
+	return model;
+}
+
+/* nearest power of 2 */
+static int log2_class(ld x)
+{
+	return x > 0 ? (int) floor(log2(x) + 0.5) : -99;
+}
+
+std::string Autotuner::key(int N, ld L, ld epsilon)
+{
+	const ld pi = acos(-1.0);
+	char buf[128];
+	snprintf(buf, sizeof(buf), "|%u|N~2^%d|neighbours~2^%d|L/eps~2^%d",
+		std::thread::hardware_concurrency(), log2_class(N),
+		log2_class(N * pi * epsilon * epsilon / (L * L)),
+		log2_class(L / epsilon));
+	return cpu_model() + buf;
+}
+
+bool Autotuner::load(const std::string &key, TuningParams &params) const
+{
+	FILE *in = fopen(file_name.c_str(), "rt");
+	if (in == NULL)
+		return false;
+	char line[1024];
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), in) != NULL) {
+		char *tab = strchr(line, '\t');
+		if (tab == NULL || std::string(line, tab) != key)
+			continue;
+		found = sscanf(tab + 1, "%d %d %d %d", &params.cells_per_epsilon,
+			&params.threads, &params.tile_cells,
+			&params.reorder_interval) == 4;
+	}
+	fclose(in);
+	return found;
+}
+
+bool Autotuner::store(const std::string &key, const TuningParams &params) const
+{
+	std::vector<std::string> lines;
+	FILE *in = fopen(file_name.c_str(), "rt");
+	if (in != NULL) {
+		char line[1024];
+		while (fgets(line, sizeof(line), in) != NULL) {
+			char *tab = strchr(line, '\t');
+			if (tab == NULL || std::string(line, tab) != key)
+				lines.push_back(line);
+		}
+		fclose(in);
+	}
+	FILE *out = fopen(file_name.c_str(), "wt");
+	if (out == NULL)
+		return false;
+	for (size_t i = 0; i < lines.size(); ++i)
+		fputs(lines[i].c_str(), out);
+	fprintf(out, "%s\t%d\t%d\t%d\t%d\n", key.c_str(),
+		params.cells_per_epsilon, params.threads, params.tile_cells,
+		params.reorder_interval);
+	return fclose(out) == 0;
+}
+
+TuningParams Autotuner::tune(const TuningParams &start, int max_threads,
+	const benchmark_t &benchmark, FILE *out) const
+{
+	std::vector<int> thread_counts;
+	for (int t = 1; t < max_threads; t *= 2)
+		thread_counts.push_back(t);
+	thread_counts.push_back(max_threads);
+	struct Axis {
+		const char *name;
+		int TuningParams::*field;
+		std::vector<int> candidates;
+	} axes[] = {
+		{ "threads", &TuningParams::threads, thread_counts },
+		{ "cells_per_epsilon", &TuningParams::cells_per_epsilon,
+			{ 2, 3, 4, 5, 6, 8 } },
+		{ "tile_cells", &TuningParams::tile_cells, { 0, 2, 4, 8, 16 } },
+		{ "reorder_interval", &TuningParams::reorder_interval,
+			{ 0, 100, 1000 } },
+	};
+	auto measure = [&] (const TuningParams &params) {
+		return std::min(benchmark(params), benchmark(params));
+	};
+	TuningParams best = start;
+	double best_time = measure(best);
+	fprintf(out, "tuning from cells_per_epsilon %d, threads %d, "
+		"tile_cells %d, reorder_interval %d: %.3lf ns per particle-step\n",
+		best.cells_per_epsilon, best.threads, best.tile_cells,
+		best.reorder_interval, 1e9 * best_time);
+	for (size_t a = 0; a < sizeof(axes) / sizeof(axes[0]); ++a) {
+		const Axis &axis = axes[a];
+		for (size_t c = 0; c < axis.candidates.size(); ++c) {
+			if (axis.candidates[c] == best.*axis.field)
+				continue;
+			TuningParams params = best;
+			params.*axis.field = axis.candidates[c];
+			double time = measure(params);
+			fprintf(out, "tuning %s = %d: %.3lf ns per particle-step\n",
+				axis.name, axis.candidates[c], 1e9 * time);
+			if (time < best_time) {
+				best_time = time;
+				best = params;
+			}
+		}
+	}
+	fprintf(out, "tuned: cells_per_epsilon %d, threads %d, tile_cells %d, "
+		"reorder_interval %d, %.3lf ns per particle-step\n",
+		best.cells_per_epsilon, best.threads, best.tile_cells,
+		best.reorder_interval, 1e9 * best_time);
+	return best;
+}
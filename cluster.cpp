@@ -1,10 +1,27 @@
+#include <algorithm>
+
 #include "cluster.h"
+#include "profiler.h"
+#include "topology.h"
 
 Cluster::Cluster(const int& N, const ld& L, bool local_visibility, const ld& epsilon,
 	bool to_use_grid)
 {
 	grid = nullptr;
 	calculate_with_grid = to_use_grid;
+	mesh = nullptr;
+	mesh_cells = 0;
+	pool = new ThreadPool(1);
+	noise_buffer = nullptr;
+	noise_buffer_steps = 0;
+	reorder_interval = 0;
+	estimate_error = false;
+	step_error = 0;
+	fixed_positions = false;
+	cells_per_epsilon = 5;
+	tile_cells = 0;
+	huge_pages = false;
+	cur_cells_known = false;
 	reinit(N, L, local_visibility, epsilon);
 }
 
@@ -14,6 +31,9 @@ Cluster::~Cluster()
 		rs[i].clear();
 		vs[i].clear();
 	}
+	delete pool;
+	delete mesh;
+	delete noise_buffer;
 }
 
 void Cluster::use_grid(bool yes)
@@ -21,6 +41,143 @@ void Cluster::use_grid(bool yes)
 	calculate_with_grid = yes;
 }
 
+void Cluster::use_mesh(int cells)
+{
+	mesh_cells = cells;
+}
+
+void Cluster::set_model(const Model &model_arg)
+{
+	model = model_arg;
+	model.prepare();
+}
+
+void Cluster::set_threads(int threads)
+{
+	if (pool->size() == threads)
+		return;
+	delete pool;
+	pool = new ThreadPool(threads);
+	/* CPUs were chosen for the old number of threads */
+	placement_cpus.clear();
+	if (noise_buffer != nullptr)
+		noise_buffer->set_placement(nullptr, false);
+}
+
+bool Cluster::set_placement(const std::vector<int> &cpus, bool huge_pages_arg)
+{
+	const int threads = pool->size();
+	delete pool;
+	pool = new ThreadPool(threads);
+	placement_cpus.clear();
+	if (!cpus.empty() && !pool->pin(cpus)) {
+		if (noise_buffer != nullptr)
+			noise_buffer->set_placement(nullptr, false);
+		return false;
+	}
+	placement_cpus = cpus;
+	huge_pages = huge_pages_arg;
+	if (noise_buffer != nullptr)
+		noise_buffer->set_placement(cpus.empty() ? nullptr : pool,
+			huge_pages);
+	return true;
+}
+
+void Cluster::place_memory()
+{
+	if (placement_cpus.empty())
+		return;
+	for (int i = 0; i < 2; ++i) {
+		first_touch(rs[i], N, *pool, huge_pages);
+		first_touch(vs[i], N, *pool, huge_pages);
+	}
+	if (!local_visibility || !calculate_with_grid)
+		return;
+	first_touch(cur_cells, N, *pool, huge_pages);
+	first_touch(next_cells, N, *pool, huge_pages);
+	if (fixed_positions) {
+		first_touch(cur_fixed, N, *pool, huge_pages);
+		first_touch(next_fixed, N, *pool, huge_pages);
+	}
+	cur_cells_known = false;
+	if (particles.empty())
+		grid->place_memory(*pool, N, huge_pages);
+}
+
+void Cluster::set_noise_seed(uint64_t seed)
+{
+	noise_gen.set_seed(seed);
+}
+
+void Cluster::set_reorder_interval(int steps)
+{
+	reorder_interval = steps;
+}
+
+void Cluster::set_error_estimate(bool yes)
+{
+	estimate_error = yes;
+	step_error = 0;
+}
+
+ld Cluster::get_step_error() const
+{
+	return step_error;
+}
+
+void Cluster::set_fixed_positions(bool yes)
+{
+	fixed_positions = yes;
+	cur_cells_known = false;
+}
+
+void Cluster::set_grid_resolution(int cells)
+{
+	if (cells == cells_per_epsilon)
+		return;
+	cells_per_epsilon = cells;
+	reinit(N, L, local_visibility, epsilon);
+}
+
+void Cluster::set_tile_cells(int cells)
+{
+	tile_cells = cells;
+}
+
+void Cluster::set_noise_buffer(int steps)
+{
+	if (steps == noise_buffer_steps)
+		return;
+	noise_buffer_steps = steps;
+	delete noise_buffer;
+	noise_buffer = nullptr;
+}
+
+ld Cluster::get_noise_underrun_fraction() const
+{
+	if (noise_buffer == nullptr || noise_buffer->get_acquired() == 0)
+		return 0;
+	return (ld) noise_buffer->get_underruns() / noise_buffer->get_acquired();
+}
+
+const Noise *Cluster::acquire_noise()
+{
+	if (noise_buffer_steps <= 0)
+		return nullptr;
+	if (noise_buffer == nullptr) {
+		noise_buffer = new NoiseBuffer(noise_buffer_steps);
+		if (!placement_cpus.empty())
+			noise_buffer->set_placement(pool, huge_pages);
+	}
+	return noise_buffer->acquire(noise_gen, N, step);
+}
+
+void Cluster::release_noise()
+{
+	if (noise_buffer_steps > 0)
+		noise_buffer->release();
+}
+
 void Cluster::reinit(const int &N_arg, const ld &L_arg,
 		bool local_visibility_arg, const ld &epsilon_arg)
 {
@@ -28,6 +185,7 @@ void Cluster::reinit(const int &N_arg, const ld &L_arg,
 	L = L_arg;
 	local_visibility = local_visibility_arg;
 	epsilon = epsilon_arg;
+	frame = FixedFrame(L);
 	for (int i = 0; i < 2; ++i) {
 		rs[i].resize(N);
 		vs[i].resize(N);
@@ -36,9 +194,30 @@ void Cluster::reinit(const int &N_arg, const ld &L_arg,
 	next_id = 1;
 	seeded = false;
 	measurement = false;
+	step = 0;
+	next_avg_known = false;
+	cur_cells_known = false;
+	crossers = 0;
+	crosser_updates = 0;
+	ids.resize(N);
+	slot_of.resize(N);
+	for (int i = 0; i < N; ++i)
+		ids[i] = slot_of[i] = i;
+	grid_rebuild = false;
+	neighbour_count.clear();
+	/* counters of underruns are kept until the next reinit */
+	delete noise_buffer;
+	noise_buffer = nullptr;
+	delete mesh;
+	mesh = nullptr;
+	if (mesh_cells > 0) {
+		mesh = new Mesh(L, mesh_cells, epsilon);
+		mesh_updated = false;
+	}
 	if (!calculate_with_grid)
 		return;
-	int cells = 5 * L / epsilon;
+	int cells = cells_per_epsilon * L / epsilon;
+	grid_cells = cells;
 	if (grid != nullptr)
 		delete grid;
 	grid = new Grid(L, L, cells, cells);
@@ -49,6 +228,7 @@ void Cluster::reinit(const int &N_arg, const ld &L_arg,
 void Cluster::seed_randomly(const ld& speed_lowest,
 			    const ld& speed_highest)
 {
+	place_memory();
 	const ld center = 0.5 * L;
 	const ld magnitude = 0.1 * L;
 	std::vector<Point> &r = get_next_coordinates();
@@ -79,6 +259,7 @@ void Cluster::seed_randomly(const ld& speed_lowest,
 void Cluster::seed_uniformly(const ld &speed_lowest,
 			     const ld &speed_highest)
 {
+	place_memory();
 	std::vector<Point> &r = get_next_coordinates();
 	std::vector<Point> &v = get_next_velocities();
 	auto ran3 = [] () { return GaussianGen::Instance().ran3_value(); };
@@ -98,8 +279,29 @@ void Cluster::seed_uniformly(const ld &speed_lowest,
 	swap_states();
 }
 
+void Cluster::seed_from_noise(const ld &speed_lowest,
+			     const ld &speed_highest)
+{
+	place_memory();
+	std::vector<Point> &r = get_next_coordinates();
+	std::vector<Point> &v = get_next_velocities();
+	/* key of no real step */
+	const uint64_t key = noise_gen.step_key(~0ULL);
+	const ld speed_range = (speed_highest - speed_lowest);
+	for (int i = 0; i < N; ++i) {
+		ld u[4];
+		noise_gen.uniforms(key, ids[i], u);
+		r[i] = Point(0.01 + u[0] * (L - 0.02), 0.01 + u[1] * (L - 0.02));
+		v[i] = Point(u[2] * speed_range + speed_lowest,
+			u[3] * speed_range + speed_lowest);
+	}
+	seeded = true;
+	swap_states();
+}
+
 void Cluster::update_grid()
 {
+	PROFILE_SCOPE(ph_grid_update);
 	std::vector<Point> &r = get_cur_coordinates();
 	std::vector<Point> &v = get_cur_velocities();
 	size_t amount = r.size();
@@ -110,14 +312,91 @@ void Cluster::update_grid()
 			particles[i] = particle;
 			grid->add(particle);
 		}
+	} else if (grid_rebuild) {
+		grid->clear();
+		for (size_t i = 0; i < amount; ++i) {
+			particles[i]->move_to(r[i]._x, r[i]._y);
+			grid->add(particles[i]);
+		}
 	} else {
-		for (size_t i = 0; i < amount; ++i)
-			grid->move(particles[i], r[i]);
+		crossers += grid->update_positions(r);
+		++crosser_updates;
 	}
+	grid_rebuild = false;
 	grid->update_for_search(&v);
 	grid_updated = true;
 }
 
+void Cluster::update_grid_parallel()
+{
+	PROFILE_SCOPE(ph_grid_update);
+	std::vector<Point> &r = get_cur_coordinates();
+	if (particles.empty()) {
+		/* each one is allocated by the thread working on it */
+		particles.resize(r.size());
+		const int blocks = (N + reduction_block - 1) / reduction_block;
+		pool->run(blocks, [&] (int block, int) {
+			int end = std::min(N, (block + 1) * reduction_block);
+			for (int i = block * reduction_block; i < end; ++i)
+				particles[i] = new Particle(i, r[i]._x, r[i]._y);
+		});
+		for (size_t i = 0; i < r.size(); ++i)
+			grid->add(particles[i]);
+	}
+	crossers += grid->rebuild(r, cur_cells, &get_cur_velocities(), *pool);
+	++crosser_updates;
+	grid_rebuild = false;
+	grid_updated = true;
+}
+
+/* interleaves lower 16 bits of @x with zeros */
+static inline uint32_t spread_bits(uint32_t x)
+{
+	x &= 0xffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+void Cluster::reorder_particles()
+{
+	const std::vector<Point> &r = get_cur_coordinates();
+	const std::vector<Point> &v = get_cur_velocities();
+	std::vector<Point> &rnext = get_next_coordinates();
+	std::vector<Point> &vnext = get_next_velocities();
+	const ld scale = 65536 / L;
+	std::vector<std::pair<uint32_t, int> > order(N);
+	for (int i = 0; i < N; ++i) {
+		uint32_t qx = std::min(65535, std::max(0, (int) (r[i]._x * scale)));
+		uint32_t qy = std::min(65535, std::max(0, (int) (r[i]._y * scale)));
+		order[i] = std::make_pair(spread_bits(qx) | (spread_bits(qy) << 1), i);
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<int> new_ids(N);
+	for (int k = 0; k < N; ++k) {
+		int from = order[k].second;
+		rnext[k] = r[from];
+		vnext[k] = v[from];
+		new_ids[k] = ids[from];
+	}
+	ids.swap(new_ids);
+	for (int k = 0; k < N; ++k)
+		slot_of[ids[k]] = k;
+	if ((int) neighbour_count.size() == N) {
+		std::vector<int> counts(N);
+		for (int k = 0; k < N; ++k)
+			counts[k] = neighbour_count[order[k].second];
+		neighbour_count.swap(counts);
+	}
+	/* the set of velocities is the same, so is their average */
+	const bool avg_known = next_avg_known;
+	swap_states();
+	next_avg_known = avg_known;
+	grid_rebuild = true;
+}
+
 std::vector<Point> &Cluster::get_cur_coordinates()
 {
 	return rs[cur_id];
@@ -142,43 +421,340 @@ void Cluster::swap_states()
 {
 	std::swap(cur_id, next_id);
 	grid_updated = false;
+	mesh_updated = false;
+	next_avg_known = false;
+	cur_cells_known = false;
 }
 
 void Cluster::evolve(speed_integrator speed_step,
 		position_integrator position_step)
 {
+	if (reorder_interval > 0 && step > 0 && step % reorder_interval == 0)
+		reorder_particles();
 	std::vector<Point> &r = get_cur_coordinates();
 	std::vector<Point> &rnext = get_next_coordinates();
 	std::vector<Point> &v = get_cur_velocities();
 	std::vector<Point> &vnext = get_next_velocities();
 	if (local_visibility) {
+		PROFILE_LOCAL(neighbour_ticks);
+		PROFILE_LOCAL(integration_ticks);
 		for (int i = 0; i < N; ++i) {
 			Point u_A;
-			if (calculate_with_grid)
+			PROFILE_START(neighbour_ticks);
+			if (mesh != nullptr)
+				u_A = get_disc_speed_with_mesh(i);
+			else if (calculate_with_grid)
 				u_A = get_disc_speed_with_grid(i);
 			else
 				u_A = get_mean_field_speed(i);
+			PROFILE_STOP(neighbour_ticks);
+			PROFILE_START(integration_ticks);
 			rnext[i] = position_step(r[i], v[i]);
 			rnext[i].normalize_to_rect(0, L, 0, L);
 			vnext[i] = speed_step(v[i], u_A);
+			PROFILE_STOP(integration_ticks);
 		}
+		PROFILE_FLUSH(ph_neighbours, neighbour_ticks);
+		PROFILE_FLUSH(ph_integration, integration_ticks);
 		if (measurement) {
-			avg_speed += get_avg_speed().length();
+			PROFILE_SCOPE(ph_measurement);
+			avg_speed.add(get_avg_speed().length());
 			++avg_denominator;
 		}
 	} else {
-		Point u_A = get_avg_speed();
+		Point u_A;
+		{
+			/* alignment field, the mean one for global visibility */
+			PROFILE_SCOPE(ph_neighbours);
+			u_A = get_avg_speed();
+		}
 		if (measurement) {
-			avg_speed += u_A.length();
+			avg_speed.add(u_A.length());
 			++avg_denominator;
 		}
+		PROFILE_SCOPE(ph_integration);
 		for (int i = 0; i < N; ++i) {
 			rnext[i] = position_step(r[i], v[i]);
 			rnext[i].normalize_to_rect(0, L, 0, L);
 			vnext[i] = speed_step(v[i], u_A);
 		}
 	}
+	PROFILE_COUNT(cnt_steps, 1);
+	PROFILE_COUNT(cnt_particle_steps, N);
+	swap_states();
+	++step;
+}
+
+void Cluster::evolve_global()
+{
+	assert(!local_visibility);
+	if (reorder_interval > 0 && step > 0 && step % reorder_interval == 0)
+		reorder_particles();
+	const std::vector<Point> &r = get_cur_coordinates();
+	std::vector<Point> &rnext = get_next_coordinates();
+	const std::vector<Point> &v = get_cur_velocities();
+	std::vector<Point> &vnext = get_next_velocities();
+	const int blocks = (N + reduction_block - 1) / reduction_block;
+
+	if (!next_avg_known) {
+		PROFILE_SCOPE(ph_neighbours);
+		next_avg_speed = get_avg_speed();
+	}
+	const Point u_A = next_avg_speed;
+	if (measurement) {
+		avg_speed.add(u_A.length());
+		++avg_denominator;
+	}
+
+	const uint64_t key = noise_gen.step_key(step);
+	const Noise *ready = acquire_noise();
+	block_sums.assign(blocks, PointSum());
+	error_sums.assign(blocks, KahanSum());
+	pool->run(blocks, [&] (int block, int) {
+		PROFILE_SCOPE(ph_integration);
+		PROFILE_LOCAL(noise_ticks);
+		int end = std::min(N, (block + 1) * reduction_block);
+		PointSum &sum = block_sums[block];
+		KahanSum &error_sum = error_sums[block];
+		Noise xi;
+		ld error;
+		for (int i = block * reduction_block; i < end; ++i) {
+			Point rn = model.heun_position(r[i], v[i]);
+			wrap(rn);
+			rnext[i] = rn;
+			PROFILE_START(noise_ticks);
+			if (ready != nullptr)
+				xi = ready[ids[i]];
+			else
+				noise_gen.noise(key, ids[i], &xi);
+			PROFILE_STOP(noise_ticks);
+			Point vn = model.speed(v[i], u_A, xi,
+				estimate_error ? &error : nullptr);
+			vnext[i] = vn;
+			sum.add(vn);
+			if (estimate_error)
+				error_sum.add(error);
+		}
+		PROFILE_FLUSH(ph_noise, noise_ticks);
+	});
+	release_noise();
+	PROFILE_COUNT(cnt_steps, 1);
+	PROFILE_COUNT(cnt_particle_steps, N);
+	swap_states();
+	++step;
+	{
+		PROFILE_SCOPE(ph_neighbours);
+		next_avg_speed = reduce_block_sums();
+	}
+	next_avg_known = true;
+	reduce_error_sums();
+}
+
+/* the same as Point::normalize_to_rect(0, L, 0, L) */
+inline void Cluster::wrap(Point &p) const
+{
+	if (p._x < 0)
+		p._x += L;
+	else if (p._x > L - EPS)
+		p._x -= L;
+	if (p._y < 0)
+		p._y += L;
+	else if (p._y > L - EPS)
+		p._y -= L;
+}
+
+void Cluster::evolve_parallel()
+{
+	if (!local_visibility) {
+		evolve_global();
+		return;
+	}
+	assert(calculate_with_grid && mesh == nullptr);
+	evolve_tiled();
+}
+
+void Cluster::find_cells()
+{
+	const std::vector<Point> &r = get_cur_coordinates();
+	const int blocks = (N + reduction_block - 1) / reduction_block;
+	cur_cells.resize(N);
+	cur_fixed.resize(fixed_positions ? N : 0);
+	pool->run(blocks, [&] (int block, int) {
+		int begin = block * reduction_block;
+		int end = std::min(N, begin + reduction_block);
+		if (!fixed_positions) {
+			grid->cell_indices(&r[begin], end - begin, &cur_cells[begin]);
+			return;
+		}
+		for (int i = begin; i < end; ++i) {
+			cur_fixed[i] = frame.to_fixed(r[i]);
+			cur_cells[i] = grid->cell_index(cur_fixed[i]);
+		}
+	});
+	cur_cells_known = true;
+}
+
+void Cluster::bin_into_tiles()
+{
+	const int tiles = tiles_per_side * tiles_per_side;
+	tile_start.assign(tiles + 1, 0);
+	tile_cost.assign(tiles, 0);
+	tile_members.resize(N);
+	/* counting sort of particles by tiles */
+	std::vector<int> tile_index(N);
+	for (int i = 0; i < N; ++i) {
+		int tx = cur_cells[i] / grid_cells * tiles_per_side / grid_cells;
+		int ty = cur_cells[i] % grid_cells * tiles_per_side / grid_cells;
+		int tile = tx * tiles_per_side + ty;
+		tile_index[i] = tile;
+		++tile_start[tile + 1];
+		tile_cost[tile] += 1 + neighbour_count[i];
+	}
+	for (int t = 0; t < tiles; ++t)
+		tile_start[t + 1] += tile_start[t];
+	std::vector<int> fill(tile_start.begin(), tile_start.end() - 1);
+	for (int i = 0; i < N; ++i)
+		tile_members[fill[tile_index[i]]++] = i;
+}
+
+void Cluster::evolve_tiled()
+{
+	if (reorder_interval > 0 && step > 0 && step % reorder_interval == 0)
+		reorder_particles();
+	if (!cur_cells_known)
+		find_cells();
+	grid->set_fixed_positions(fixed_positions ? &cur_fixed : NULL, frame);
+	if (!grid_updated)
+		update_grid_parallel();
+	else
+		grid->update_cell_sums();
+
+	const std::vector<Point> &r = get_cur_coordinates();
+	std::vector<Point> &rnext = get_next_coordinates();
+	const std::vector<Point> &v = get_cur_velocities();
+	std::vector<Point> &vnext = get_next_velocities();
+	const int workers = pool->size();
+	/**
+	 * tiles don't depend on number of workers, so the order
+	 * parameter summed by tiles doesn't as well; 64^2 tiles
+	 * are at least 16 per worker up to 256 workers
+	 */
+	if (tile_cells > 0)
+		tiles_per_side = (grid_cells + tile_cells - 1) / tile_cells;
+	else
+		tiles_per_side = std::min(grid_cells, 64);
+	const int tiles = tiles_per_side * tiles_per_side;
+	if ((int) neighbour_count.size() != N)
+		neighbour_count.assign(N, 0);
+	bin_into_tiles();
+	scheduler.plan(tile_cost, workers);
+	if (measurement) {
+		PROFILE_SCOPE(ph_measurement);
+		if (!next_avg_known)
+			next_avg_speed = get_avg_speed();
+		avg_speed.add(next_avg_speed.length());
+		++avg_denominator;
+	}
+
+	/**
+	 * fused pass: new position, its wrap, its cell for the next
+	 * rebuild and contribution to the next order parameter
+	 * are produced while the particle is at hand
+	 */
+	const uint64_t key = noise_gen.step_key(step);
+	const Noise *ready = acquire_noise();
+	next_cells.resize(N);
+	next_fixed.resize(fixed_positions ? N : 0);
+	tile_sums.resize(tiles);
+	error_sums.assign(tiles, KahanSum());
+#ifdef PROFILE
+	/* state arrays streamed per particle, for the modelled traffic */
+	const long long particle_bytes = 4 * sizeof(Point) + 4 * sizeof(int) +
+		(fixed_positions ? 2 * sizeof(FixedPoint) : 0) +
+		(ready != nullptr ? sizeof(Noise) : 0);
+#endif
+	pool->run(workers, [&] (int worker, int) {
+		PROFILE_LOCAL(query_ticks);
+		Noise xi;
+		ld error;
+#ifdef PROFILE
+		long long done = 0;
+#endif
+		for (int tile = scheduler.next(worker); tile >= 0;
+				tile = scheduler.next(worker)) {
+#ifdef PROFILE
+			done += tile_start[tile + 1] - tile_start[tile];
+#endif
+			PointSum sum;
+			KahanSum &error_sum = error_sums[tile];
+			for (int k = tile_start[tile]; k < tile_start[tile + 1]; ++k) {
+				int i = tile_members[k];
+				PROFILE_START(query_ticks);
+				Point u_A = grid->get_disc_speed(*particles[i], epsilon,
+					neighbour_count[i]);
+				PROFILE_STOP(query_ticks);
+				if (fixed_positions) {
+					FixedPoint fn = frame.advance(cur_fixed[i],
+						model.heun_position(Point(0, 0), v[i]));
+					next_fixed[i] = fn;
+					rnext[i] = frame.to_point(fn);
+					next_cells[i] = grid->cell_index(fn);
+				} else {
+					Point rn = model.heun_position(r[i], v[i]);
+					wrap(rn);
+					rnext[i] = rn;
+					next_cells[i] = grid->cell_index(rn);
+				}
+				if (ready != nullptr)
+					xi = ready[ids[i]];
+				else
+					noise_gen.noise(key, ids[i], &xi);
+				Point vn = model.speed(v[i], u_A, xi,
+					estimate_error ? &error : nullptr);
+				vnext[i] = vn;
+				sum.add(vn);
+				if (estimate_error)
+					error_sum.add(error);
+			}
+			tile_sums[tile] = sum;
+		}
+		PROFILE_FLUSH(ph_neighbours, query_ticks);
+		PROFILE_BYTES(Topology::Instance().current_node(),
+			done * particle_bytes);
+	});
+	release_noise();
+	PROFILE_COUNT(cnt_steps, 1);
+	PROFILE_COUNT(cnt_particle_steps, N);
 	swap_states();
+	cur_cells.swap(next_cells);
+	cur_fixed.swap(next_fixed);
+	cur_cells_known = true;
+	++step;
+	PROFILE_SCOPE(ph_measurement);
+	PointSum total;
+	for (int t = 0; t < tiles; ++t)
+		total.add(tile_sums[t]);
+	next_avg_speed = total.value() * (1. / N);
+	next_avg_known = true;
+	reduce_error_sums();
+}
+
+Point Cluster::reduce_block_sums() const
+{
+	PointSum sum;
+	for (size_t i = 0; i < block_sums.size(); ++i)
+		sum.add(block_sums[i]);
+	return sum.value() * (1. / N);
+}
+
+void Cluster::reduce_error_sums()
+{
+	if (!estimate_error)
+		return;
+	KahanSum sum;
+	for (size_t i = 0; i < error_sums.size(); ++i)
+		sum.add(error_sums[i]);
+	step_error = sqrt(sum.value() / N);
 }
 
 Point Cluster::get_mean_field_speed(int particleId)
@@ -228,6 +804,8 @@ Point Cluster::get_mean_field_speed(int particleId)
 		++particles_found_naive;
 		field_speed = field_speed + v[i];
 	}
+	PROFILE_COUNT(cnt_queries, 1);
+	PROFILE_COUNT(cnt_neighbours, particles_found_naive);
 	if (particles_found_naive == 0)
 		return field_speed;
 	return field_speed / particles_found_naive;
@@ -241,14 +819,96 @@ Point Cluster::get_disc_speed_with_grid(int particleId)
 	return grid->get_disc_speed(*(particles[particleId]), epsilon);
 }
 
-Point Cluster::get_avg_speed() const
+Point Cluster::get_disc_speed_with_mesh(int particleId)
 {
-	const std::vector<Point> &v = vs[cur_id];
-	Point avg_speed(0,0);
+	if (!mesh_updated) {
+		PROFILE_SCOPE(ph_grid_update);
+		mesh->deposit(get_cur_coordinates(), get_cur_velocities());
+		mesh_updated = true;
+	}
+	PROFILE_COUNT(cnt_queries, 1);
+	return mesh->get_disc_speed(get_cur_coordinates()[particleId],
+			get_cur_velocities()[particleId]);
+}
+
+void Cluster::report_mesh_error(FILE *out, int samples)
+{
+	assert(mesh != nullptr);
+	std::vector<Point> &r = get_cur_coordinates();
+	std::vector<Point> &v = get_cur_velocities();
+	int cells = 5 * L / epsilon;
+	Grid exact(L, L, cells, cells);
+	std::vector<Particle> all;
+	all.reserve(N);
 	for (int i = 0; i < N; ++i) {
-		avg_speed = avg_speed + v[i];
+		all.push_back(Particle(i, r[i]._x, r[i]._y));
+		exact.add(&all[i]);
+	}
+	exact.update_for_search(&v);
+
+	KahanSum abs_error, exact_norm;
+	int stride = std::max(1, N / std::max(1, samples));
+	int sampled = 0;
+	for (int i = 0; i < N && sampled < samples; i += stride, ++sampled) {
+		Point approx = get_disc_speed_with_mesh(i);
+		Point precise = exact.get_disc_speed(all[i], epsilon);
+		abs_error.add((approx - precise).length());
+		exact_norm.add(precise.length());
+	}
+	ld mean_error = abs_error.value() / std::max(1, sampled);
+	ld mean_norm = exact_norm.value() / std::max(1, sampled);
+	fprintf(out, "mesh vs grid on %d particles: mean |du| = %lf, "
+		"relative to mean |u_A| = %lf\n", sampled, mean_error,
+		mean_norm > 0 ? mean_error / mean_norm : 0);
+}
+
+void Cluster::report_local_order(FILE *out, const std::vector<ld> &radii)
+{
+	std::vector<Point> &r = get_cur_coordinates();
+	std::vector<Point> &v = get_cur_velocities();
+	const int k = (int) radii.size();
+	int cells = 5 * L / radii[k - 1];
+	Grid search(L, L, cells, cells);
+	std::vector<Particle> all;
+	all.reserve(N);
+	for (int i = 0; i < N; ++i) {
+		all.push_back(Particle(i, r[i]._x, r[i]._y));
+		search.add(&all[i]);
+	}
+	search.update_for_search(&v);
+	search.update_cell_sums();
+
+	/* per particle values first, so that sums don't depend on threads */
+	std::vector<ld> order(N * k);
+	std::vector<int> found(N * k);
+	const int chunks = (N + reduction_block - 1) / reduction_block;
+	pool->run(chunks, [&] (int chunk, int) {
+		Point sums[Grid::max_radii];
+		int end = std::min(N, (chunk + 1) * reduction_block);
+		for (int i = chunk * reduction_block; i < end; ++i) {
+			search.get_disc_speeds(all[i], radii, sums, &found[i * k]);
+			for (int j = 0; j < k; ++j)
+				order[i * k + j] = (sums[j] / found[i * k + j]).length();
+		}
+	});
+	for (int j = 0; j < k; ++j) {
+		KahanSum order_sum, neighbours;
+		for (int i = 0; i < N; ++i) {
+			order_sum.add(order[i * k + j]);
+			neighbours.add(found[i * k + j] - 1);
+		}
+		fprintf(out, "local order in disc of radius %lf: %lf, "
+			"neighbours: %lf\n", radii[j], order_sum.value() / N,
+			neighbours.value() / N);
 	}
-	return avg_speed * (1. / N);
+}
+
+Point Cluster::get_avg_speed() const
+{
+	const std::vector<Point> &v = vs[cur_id];
+	PointSum sum = blocked_sum(*pool, N, block_sums,
+		[&] (int i) -> const Point & { return v[i]; });
+	return sum.value() * (1. / N);
 }
 
 ld Cluster::get_avg_speed_val() const
@@ -256,6 +916,13 @@ ld Cluster::get_avg_speed_val() const
 	return get_avg_speed().length();
 }
 
+ld Cluster::get_crosser_fraction() const
+{
+	if (crosser_updates == 0)
+		return 0;
+	return (ld) crossers / crosser_updates / N;
+}
+
 void Cluster::init_log(const char *log_file)
 {
 	log = fopen(log_file, "wt");
@@ -274,7 +941,7 @@ void Cluster::log_positions()
 	assert(log);
 	std::vector<Point> &r = rs[cur_id];
 	for (size_t i = 0; i < r.size(); ++i) {
-		r[i].to_string(buffer, ' ', '\t');
+		r[slot_of[i]].to_string(buffer, ' ', '\t');
 		fprintf(log, "%s", buffer);
 	}
 	fprintf(log, "\n");
@@ -284,12 +951,14 @@ void Cluster::start_speed_measurement()
 {
 	measurement = true;
 	avg_denominator = 0;
-	avg_speed = 0.0;
+	avg_speed = KahanSum();
+	crossers = 0;
+	crosser_updates = 0;
 }
 
 ld Cluster::get_measurement() const
 {
 	if (avg_denominator == 0)
 		return -1.0;
-	return avg_speed / avg_denominator;
+	return avg_speed.value() / avg_denominator;
 }
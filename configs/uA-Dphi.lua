@@ -5,6 +5,64 @@ integration = {
 	},
 	time_step = 0.005,
 	use_grid = true,
+	-- if > 0, speed in disc is approximated on mesh of
+	-- @mesh_cells x @mesh_cells cells instead (for very large N)
+	mesh_cells = 0,
+	-- worker threads used by parallel stepping
+	threads = 1,
+	-- parallel engine: "none", "compact" (fill NUMA nodes one by one)
+	-- or "scatter" (deal threads to nodes in turn) pinning of @threads
+	-- to CPUs; pinned threads work on fixed parts of particles, whose
+	-- arrays they touch first, so the pages stay on their nodes
+	pinning = "none",
+	-- with pinning: arrays are put on transparent huge pages
+	huge_pages = false,
+	-- profiling build (make PROFILE=1): GB/s one NUMA node can stream
+	-- (e.g. by STREAM), the modelled traffic of the parallel engine,
+	-- i.e. sizes of arrays it streams, is shown as a share of it;
+	-- 0 leaves the share out
+	peak_bandwidth = 0,
+	-- vector kernels: "sse2", "avx2", "avx512" or "auto" (the best one
+	-- CPU supports); all give the same results, it's for benchmarks
+	isa = "auto",
+	-- "serial" or "parallel": the latter steps on all @threads,
+	-- its noise depends only on @seed and D_phi point, not on @threads;
+	-- with local visibility it requires @use_grid
+	-- "distributed" splits the box between MPI ranks (local visibility
+	-- only), build it by `make mpi`, run by `mpirun -np 4 ./simulation_mpi`
+	engine = "serial",
+	seed = 0,
+	-- renumber particles in Morton order of positions every N steps,
+	-- keeps neighbours close in memory; 0 turns it off. Noise of
+	-- the parallel engine follows particles, but sums are taken in
+	-- the new order, so results agree up to rounding, not bitwise
+	reorder_interval = 0,
+	-- parallel engine: noise is generated this many steps ahead
+	-- by a separate thread; 0 turns it off
+	noise_buffer = 0,
+	-- parallel engine, local visibility: positions are kept as 32-bit
+	-- fractions of rectangle_size (resolution L / 2^32), periodic wrap
+	-- is integer overflow, cells and distances are integer arithmetic
+	fixed_positions = false,
+	-- grid cells per epsilon along a side, and side of tiles of the
+	-- parallel step in cells (0: at most 64 x 64 tiles); results
+	-- differ only by rounding, see also tuning below
+	cells_per_epsilon = 5,
+	tile_cells = 0,
+	-- parallel engine: relaxation (of the same duration) with
+	-- adaptive time step, local error per step is kept about
+	-- @tolerance; 0 turns it off
+	adaptive = {
+		tolerance = 0,
+		max_time_step = 0.05,
+	},
+	-- parallel engine: "heun" or "split"; the latter solves linear
+	-- relaxation exactly and rotates velocity in polar form,
+	-- so it's stable with several times larger @time_step
+	scheme = "heun",
+	-- parallel engine: if > 0, every point is measured once more by Heun
+	-- scheme with this time step and put to the third column of the log
+	reference_time_step = 0,
 }
 model = {
 	number_of_particles = 10000,
@@ -21,7 +79,15 @@ model = {
 			finish	= 0.50,
 			step	= 0.01,
 			-- if @log_step present, then @step will be ignored
-			log_step = math.pow(10 / 3.0, 1 / 6.0)
+			log_step = math.pow(10 / 3.0, 1 / 6.0),
+			-- optional: after the points above, the interval where
+			-- order parameter changes most is bisected until it's
+			-- not wider than @resolution (0 turns it off); log lines
+			-- go in order of measurement, not of D_phi
+			refine = {
+				resolution = 0,
+				max_points = 40,
+			},
 		}
 	},
 	speed = {
@@ -30,3 +96,67 @@ model = {
 	}
 }
 
+-- optional: structured progress lines instead of the ASCII bar,
+-- @output is "stderr", "stdout" or a file name, @interval in seconds
+--[[
+progress = {
+	output = "stderr",
+	interval = 30
+}
+--]]
+
+-- optional: run a set of parameter points instead of the D_phi range
+-- (parallel engine, fixed time step); names are those of @model:
+-- number_of_particles, epsilon, mu, passive_noise, angular_noise.
+-- @axes gives Cartesian product (D_phi range is added as an axis
+-- unless angular_noise is listed), or @points lists tables explicitly;
+-- @jobs points run at once, each on integration.threads / @jobs threads,
+-- the most expensive (by N, iterations and neighbours in disc) first
+--[[
+sweep = {
+	axes = {
+		number_of_particles = { 5000, 10000, 20000 },
+		mu = { 0.5, 1.0 },
+	},
+	-- points = { { mu = 1.0, angular_noise = 0.1 }, { mu = 2.0 } },
+	jobs = 4,
+}
+--]]
+
+-- optional: measured points are stored in @directory and not simulated
+-- again by runs with the same parameters and seed; @version is a part
+-- of every key, by default it's the commit the binary was built from,
+-- change it (or remove @directory) to drop stored results.
+-- Serial engine takes initial state and noise from one global stream,
+-- so its points cached in other runs are equivalent statistically,
+-- not bitwise. Runs with @tuning use a cache namespace of their own:
+-- tuned cells_per_epsilon and reorder_interval change rounding, so
+-- their points are neither taken from nor given to untuned runs
+--[[
+cache = {
+	directory = "cache",
+	-- version = "v1",
+}
+--]]
+
+-- optional: at the end of every point, mean |mean velocity in disc|
+-- and number of neighbours for each of ascending radii (at most 16,
+-- less than rectangle_size / 2), found in one pass over neighbours
+--[[
+observables = {
+	local_order_radii = { 0.05, 0.1, 0.2, 0.4 },
+}
+--]]
+
+-- optional, parallel engine with local visibility: threads,
+-- cells_per_epsilon, tile_cells and reorder_interval are replaced by
+-- those tuned for this CPU and class of system (N, density, L/epsilon)
+-- in @file; "load" only takes them from there, "auto" also finds them
+-- by short benchmarks of a reduced system and stores them if absent;
+-- cached results of tuned runs are kept apart (see @cache)
+--[[
+tuning = {
+	mode = "auto",
+	file = "tuning.txt",
+}
+--]]
@@ -0,0 +1,291 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include "domain.h"
+
+Domain::Domain(MPI_Comm comm, int N, ld L, ld epsilon) :
+	comm(comm), N(N), L(L), epsilon(epsilon)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &ranks);
+	left = (rank + ranks - 1) % ranks;
+	right = (rank + 1) % ranks;
+	width = L / ranks;
+	x0 = rank * width;
+	if (ranks == 1) {
+		int cells = 5 * L / epsilon;
+		grid = new Grid(L, L, cells, cells);
+	} else {
+		/* halos must not overlap each other and the neighbours' ones */
+		assert(width >= epsilon && width + 2 * epsilon < L);
+		ld xsize = width + 2 * epsilon;
+		grid = new Grid(xsize, L, (int) (5 * xsize / epsilon),
+			(int) (5 * L / epsilon));
+	}
+	step = 0;
+	measurement = false;
+	avg_denominator = 0;
+}
+
+Domain::~Domain()
+{
+	delete grid;
+	for (size_t i = 0; i < particles.size(); ++i)
+		delete particles[i];
+}
+
+void Domain::set_model(const Model &model_arg)
+{
+	model = model_arg;
+	model.prepare();
+}
+
+void Domain::set_noise_seed(uint64_t seed)
+{
+	noise_gen.set_seed(seed);
+}
+
+/* the same as Cluster::wrap */
+inline void Domain::wrap(Point &p) const
+{
+	if (p._x < 0)
+		p._x += L;
+	else if (p._x > L - EPS)
+		p._x -= L;
+	if (p._y < 0)
+		p._y += L;
+	else if (p._y > L - EPS)
+		p._y -= L;
+}
+
+void Domain::seed_uniformly(ld speed_lowest, ld speed_highest)
+{
+	/* key of no real step */
+	const uint64_t key = noise_gen.step_key(~0ULL);
+	r.clear();
+	v.clear();
+	ids.clear();
+	for (int id = 0; id < N; ++id) {
+		ld u[4];
+		noise_gen.uniforms(key, id, u);
+		Point position(u[0] * L, u[1] * L);
+		wrap(position);
+		int owner = std::min(ranks - 1, (int) (position._x / width));
+		if (owner != rank)
+			continue;
+		r.push_back(position);
+		v.push_back(Point(
+			speed_lowest + (speed_highest - speed_lowest) * u[2],
+			speed_lowest + (speed_highest - speed_lowest) * u[3]));
+		ids.push_back(id);
+	}
+	step = 0;
+}
+
+void Domain::pack(std::vector<double> &buffer, int i) const
+{
+	buffer.push_back(r[i]._x);
+	buffer.push_back(r[i]._y);
+	buffer.push_back(v[i]._x);
+	buffer.push_back(v[i]._y);
+	buffer.push_back(ids[i]);
+}
+
+void Domain::exchange()
+{
+	int sent_left = (int) to_left.size();
+	int sent_right = (int) to_right.size();
+	int got_left, got_right;
+	MPI_Sendrecv(&sent_left, 1, MPI_INT, left, 0,
+		&got_right, 1, MPI_INT, right, 0, comm, MPI_STATUS_IGNORE);
+	MPI_Sendrecv(&sent_right, 1, MPI_INT, right, 1,
+		&got_left, 1, MPI_INT, left, 1, comm, MPI_STATUS_IGNORE);
+	from_left.resize(got_left);
+	from_right.resize(got_right);
+	MPI_Sendrecv(to_left.data(), sent_left, MPI_DOUBLE, left, 2,
+		from_right.data(), got_right, MPI_DOUBLE, right, 2,
+		comm, MPI_STATUS_IGNORE);
+	MPI_Sendrecv(to_right.data(), sent_right, MPI_DOUBLE, right, 3,
+		from_left.data(), got_left, MPI_DOUBLE, left, 3,
+		comm, MPI_STATUS_IGNORE);
+}
+
+void Domain::exchange_halo()
+{
+	if (ranks == 1)
+		return;
+	const int owned = (int) ids.size();
+	to_left.clear();
+	to_right.clear();
+	for (int i = 0; i < owned; ++i) {
+		if (r[i]._x < x0 + epsilon)
+			pack(to_left, i);
+		if (r[i]._x >= x0 + width - epsilon)
+			pack(to_right, i);
+	}
+	exchange();
+	const std::vector<double> *from[2] = { &from_left, &from_right };
+	for (int k = 0; k < 2; ++k) {
+		const std::vector<double> &buffer = *from[k];
+		for (size_t j = 0; j < buffer.size(); j += record_size) {
+			r.push_back(Point(buffer[j], buffer[j + 1]));
+			v.push_back(Point(buffer[j + 2], buffer[j + 3]));
+		}
+	}
+}
+
+void Domain::migrate()
+{
+	if (ranks == 1)
+		return;
+	const int owned = (int) ids.size();
+	to_left.clear();
+	to_right.clear();
+	int kept = 0;
+	for (int i = 0; i < owned; ++i) {
+		int owner = std::min(ranks - 1, (int) (r[i]._x / width));
+		if (owner == rank) {
+			r[kept] = r[i];
+			v[kept] = v[i];
+			ids[kept] = ids[i];
+			++kept;
+		} else if (owner == left) {
+			pack(to_left, i);
+		} else {
+			/* a step can't be longer than a slab */
+			assert(owner == right);
+			pack(to_right, i);
+		}
+	}
+	r.resize(kept);
+	v.resize(kept);
+	ids.resize(kept);
+	exchange();
+	const std::vector<double> *from[2] = { &from_left, &from_right };
+	for (int k = 0; k < 2; ++k) {
+		const std::vector<double> &buffer = *from[k];
+		for (size_t j = 0; j < buffer.size(); j += record_size) {
+			r.push_back(Point(buffer[j], buffer[j + 1]));
+			v.push_back(Point(buffer[j + 2], buffer[j + 3]));
+			ids.push_back((int) buffer[j + 4]);
+		}
+	}
+}
+
+void Domain::build_grid()
+{
+	const int total = (int) r.size();
+	while ((int) particles.size() < total)
+		particles.push_back(new Particle(particles.size(), 0, 0));
+	grid->clear();
+	const ld shift = x0 - epsilon;
+	for (int i = 0; i < total; ++i) {
+		ld x = r[i]._x;
+		if (ranks > 1) {
+			x -= shift;
+			if (x < 0)
+				x += L;
+			else if (x >= L)
+				x -= L;
+		}
+		particles[i]->move_to(x, r[i]._y);
+		grid->add(particles[i]);
+	}
+	grid->update_for_search(&v);
+	grid->update_cell_sums();
+}
+
+void Domain::evolve()
+{
+	if (measurement) {
+		avg_speed.add(get_avg_speed_val());
+		++avg_denominator;
+	}
+	exchange_halo();
+	build_grid();
+
+	const int owned = (int) ids.size();
+	const uint64_t key = noise_gen.step_key(step);
+	rnext.resize(owned);
+	vnext.resize(owned);
+	Noise xi;
+	int found;
+	for (int i = 0; i < owned; ++i) {
+		Point u_A = grid->get_disc_speed(*particles[i], epsilon, found);
+		Point rn = model.heun_position(r[i], v[i]);
+		wrap(rn);
+		rnext[i] = rn;
+		noise_gen.noise(key, ids[i], &xi);
+		vnext[i] = model.speed(v[i], u_A, xi);
+	}
+	r.swap(rnext);
+	v.swap(vnext);
+	++step;
+	migrate();
+}
+
+Point Domain::get_sum_speed() const
+{
+	PointSum sum;
+	for (size_t i = 0; i < ids.size(); ++i)
+		sum.add(v[i]);
+	Point local = sum.value();
+	double parts[2] = { local._x, local._y };
+	double total[2];
+	MPI_Allreduce(parts, total, 2, MPI_DOUBLE, MPI_SUM, comm);
+	return Point(total[0], total[1]);
+}
+
+ld Domain::get_avg_speed_val() const
+{
+	return (get_sum_speed() / N).length();
+}
+
+void Domain::start_speed_measurement()
+{
+	measurement = true;
+	avg_denominator = 0;
+	avg_speed = KahanSum();
+}
+
+ld Domain::get_measurement() const
+{
+	if (avg_denominator == 0)
+		return -1.0;
+	return avg_speed.value() / avg_denominator;
+}
+
+void Domain::gather(std::vector<Point> &r_all, std::vector<Point> &v_all) const
+{
+	std::vector<double> records;
+	for (size_t i = 0; i < ids.size(); ++i) {
+		records.push_back(r[i]._x);
+		records.push_back(r[i]._y);
+		records.push_back(v[i]._x);
+		records.push_back(v[i]._y);
+		records.push_back(ids[i]);
+	}
+	int count = (int) records.size();
+	std::vector<int> counts(ranks), offsets(ranks);
+	MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+	std::vector<double> all;
+	if (rank == 0) {
+		int total = 0;
+		for (int k = 0; k < ranks; ++k) {
+			offsets[k] = total;
+			total += counts[k];
+		}
+		all.resize(total);
+	}
+	MPI_Gatherv(records.data(), count, MPI_DOUBLE, all.data(),
+		counts.data(), offsets.data(), MPI_DOUBLE, 0, comm);
+	if (rank != 0)
+		return;
+	r_all.assign(N, Point(0, 0));
+	v_all.assign(N, Point(0, 0));
+	for (size_t j = 0; j < all.size(); j += record_size) {
+		int id = (int) all[j + 4];
+		r_all[id] = Point(all[j], all[j + 1]);
+		v_all[id] = Point(all[j + 2], all[j + 3]);
+	}
+}
@@ -4,6 +4,8 @@
  */
 
 #include "grid.h"
+#include "profiler.h"
+#include "topology.h"
 
 template<typename T> static inline T square(const T& x)
 {
@@ -25,6 +27,13 @@ Grid::Grid(double xsize, double ysize,
 	cells = std::vector<std::vector<Particle*> >(xcells,
 		std::vector<Particle*>(ycells, NULL));
 	used = new int[xcells * ycells];
+	velocities = NULL;
+	column_words = (ycells + 63) / 64;
+	occupancy.assign(xcells * column_words, 0);
+	column_occupied.assign(xcells, 0);
+	cell_sums_valid = false;
+	rebuild_cells = NULL;
+	fixed_positions = NULL;
 }
 
 Grid::~Grid()
@@ -32,17 +41,69 @@ Grid::~Grid()
 	delete[] used;
 }
 
-void Grid::add(Particle *particle)
+void Grid::link(Particle *particle, int cell_x, int cell_y)
 {
-	int cell_x = (int) (particle->get_x() / cell_xsize);
-	int cell_y = (int) (particle->get_y() / cell_ysize);
+	link_unchecked(particle, cell_x, cell_y);
+	cell_sums_valid = false;
+}
 
+void Grid::link_unchecked(Particle *particle, int cell_x, int cell_y)
+{
 	particle->prev = NULL;
 	particle->next = cells[cell_x][cell_y];
 	cells[cell_x][cell_y] = particle;
 
-	if (particle->next != NULL)
+	if (particle->next != NULL) {
 		particle->next->prev = particle;
+	} else {
+		occupancy[cell_x * column_words + (cell_y >> 6)] |=
+			1ULL << (cell_y & 63);
+		++column_occupied[cell_x];
+	}
+	cell_of[particle->get_id()] = cell_x * ycells + cell_y;
+}
+
+void Grid::unlink(Particle *particle, int cell_x, int cell_y)
+{
+	if (particle->prev != NULL)
+		particle->prev->next = particle->next;
+	else if (cells[cell_x][cell_y] == particle)
+		cells[cell_x][cell_y] = particle->next;
+	else
+		assert(0);
+
+	if (particle->next != NULL)
+		particle->next->prev = particle->prev;
+
+	if (cells[cell_x][cell_y] == NULL) {
+		occupancy[cell_x * column_words + (cell_y >> 6)] &=
+			~(1ULL << (cell_y & 63));
+		--column_occupied[cell_x];
+	}
+}
+
+void Grid::add(Particle *particle)
+{
+	int cell_x = get_cell_x(particle->get_x());
+	int cell_y = get_cell_y(particle->get_y());
+
+	size_t id = particle->get_id();
+	if (id >= by_id.size()) {
+		by_id.resize(id + 1, NULL);
+		cell_of.resize(id + 1, -1);
+	}
+	by_id[id] = particle;
+	link(particle, cell_x, cell_y);
+}
+
+void Grid::clear()
+{
+	for (int i = 0; i < xcells; ++i)
+		std::fill(cells[i].begin(), cells[i].end(), (Particle *) NULL);
+	std::fill(by_id.begin(), by_id.end(), (Particle *) NULL);
+	std::fill(cell_of.begin(), cell_of.end(), -1);
+	std::fill(occupancy.begin(), occupancy.end(), 0);
+	std::fill(column_occupied.begin(), column_occupied.end(), 0);
 }
 
 void Grid::update_for_search(std::vector<Point> *velocities_p)
@@ -50,6 +111,24 @@ void Grid::update_for_search(std::vector<Point> *velocities_p)
 	velocities = velocities_p;
 	memset(used, -1, xcells * ycells * sizeof *used);
 	time_cnt = 0;
+	cell_sums_valid = false;
+}
+
+void Grid::update_cell_sums()
+{
+	cell_sum.assign(xcells * ycells, Point(0, 0));
+	cell_count.assign(xcells * ycells, 0);
+	for (size_t i = 0; i < by_id.size(); ++i) {
+		int cell = cell_of[i];
+		if (cell < 0)
+			continue;
+		Point &sum = cell_sum[cell];
+		const Point &v = (*velocities)[i];
+		sum._x += v._x;
+		sum._y += v._y;
+		++cell_count[cell];
+	}
+	cell_sums_valid = true;
 }
 
 void Grid::move(Particle *particle, double nx, double ny)
@@ -58,43 +137,20 @@ void Grid::move(Particle *particle, double nx, double ny)
 	assert(-EPS < nx && nx < xsize + EPS);
 	assert(-EPS < ny && ny < ysize + EPS);
 	
-	int cell_x = (int) (particle->get_x() / cell_xsize);
-	int cell_y = (int) (particle->get_y() / cell_ysize);
+	int old = cell_of[particle->get_id()];
+	int cell_x = old / ycells;
+	int cell_y = old % ycells;
 	particle->move_to(nx, ny);
 
-	if (!(0 <= cell_x && cell_x < xcells)) {
-		printf("wrong cell_x: %d\n", cell_x);
-		fflush(stdout);
-	}
-	if (!(0 <= cell_y && cell_y < ycells)) {
-		printf("wrong cell_y: %d\n", cell_y);
-		fflush(stdout);
-	}
-
-	/* NOTE: be sure cell_n(x/y) not exceed (x/y)cells*/
-	int cell_nx = (int) (nx / cell_xsize);
-	int cell_ny = (int) (ny / cell_ysize);
+	int cell_nx = get_cell_x(nx);
+	int cell_ny = get_cell_y(ny);
 
 	if (cell_x == cell_nx && cell_y == cell_ny)
 		return;
+	PROFILE_COUNT(cnt_cell_changes, 1);
 
-	if (particle->prev != NULL)
-		particle->prev->next = particle->next;
-	else if (cells[cell_x][cell_y] == particle)
-		cells[cell_x][cell_y] = particle->next;
-	else
-		assert(0);
-
-	if (particle->next != NULL)
-		particle->next->prev = particle->prev;
-
-	/* the rest is the same as method ::add */
-	particle->prev = NULL;
-	particle->next = cells[cell_nx][cell_ny];
-	cells[cell_nx][cell_ny] = particle;
-
-	if (particle->next != NULL)
-		particle->next->prev = particle;
+	unlink(particle, cell_x, cell_y);
+	link(particle, cell_nx, cell_ny);
 }
 
 void Grid::move(Particle *particle, Point &next_pos)
@@ -102,6 +158,31 @@ void Grid::move(Particle *particle, Point &next_pos)
 	move(particle, next_pos._x, next_pos._y);
 }
 
+int Grid::update_positions(const std::vector<Point> &positions)
+{
+	const int amount = (int) by_id.size();
+	assert((int) positions.size() >= amount);
+	new_cells.resize(amount);
+	const Point *pos = positions.data();
+	int *ncell = new_cells.data();
+	cell_indices(pos, amount, ncell);
+
+	int crossers = 0;
+	for (int i = 0; i < amount; ++i) {
+		Particle *particle = by_id[i];
+		assert(particle != NULL);
+		particle->move_to(pos[i]._x, pos[i]._y);
+		int old = cell_of[i];
+		if (old == ncell[i])
+			continue;
+		unlink(particle, old / ycells, old % ycells);
+		link(particle, ncell[i] / ycells, ncell[i] % ycells);
+		++crossers;
+	}
+	PROFILE_COUNT(cnt_cell_changes, crossers);
+	return crossers;
+}
+
 bool Grid::cell_in_disc(int gx, int gy,
 	double cx, double cy, double r2) const
 {
@@ -124,6 +205,158 @@ bool Grid::cell_in_disc(int gx, int gy,
 	return false;
 }
 
+/* bounds of @chunk-th of @chunks equal ranges of [0, @amount) */
+static inline int chunk_begin(int chunk, int amount, int chunks)
+{
+	return (int) ((long long) chunk * amount / chunks);
+}
+
+int Grid::rebuild(const std::vector<Point> &positions,
+	std::vector<Point> *velocities_p, ThreadPool &pool)
+{
+	const int amount = (int) by_id.size();
+	const int chunks = pool.size();
+	new_cells.resize(amount);
+	pool.run(chunks, [&] (int t, int) {
+		int begin = chunk_begin(t, amount, chunks);
+		int end = chunk_begin(t + 1, amount, chunks);
+		cell_indices(positions.data() + begin, end - begin,
+			new_cells.data() + begin);
+	});
+	return rebuild(positions, new_cells, velocities_p, pool);
+}
+
+int Grid::rebuild(const std::vector<Point> &positions,
+	const std::vector<int> &cells_arg,
+	std::vector<Point> *velocities_p, ThreadPool &pool)
+{
+	const int amount = (int) by_id.size();
+	assert((int) positions.size() >= amount);
+	assert((int) cells_arg.size() >= amount);
+	const int chunks = std::min(pool.size(), std::max(1, xcells));
+	velocities = velocities_p;
+	rebuild_cells = &cells_arg;
+	memset(used, -1, xcells * ycells * sizeof *used);
+	time_cnt = 0;
+
+	/* buckets are ranges of columns, one per chunk */
+	column_begin.resize(chunks + 1);
+	for (int b = 0; b <= chunks; ++b)
+		column_begin[b] = chunk_begin(b, xcells, chunks);
+	histograms.resize(chunks);
+	staged.resize(amount);
+	chunk_changes.assign(chunks, 0);
+
+	/* per-chunk histograms of buckets */
+	pool.run(chunks, [&] (int t, int) {
+		std::vector<int> &hist = histograms[t];
+		hist.assign(chunks, 0);
+		int changes = 0;
+		int end = chunk_begin(t + 1, amount, chunks);
+		int bucket = 0;
+		for (int i = chunk_begin(t, amount, chunks); i < end; ++i) {
+			by_id[i]->move_to(positions[i]._x, positions[i]._y);
+			int cell = cells_arg[i];
+			int cx = cell / ycells;
+			changes += cell != cell_of[i];
+			while (cx < column_begin[bucket])
+				--bucket;
+			while (cx >= column_begin[bucket + 1])
+				++bucket;
+			++hist[bucket];
+		}
+		chunk_changes[t] = changes;
+	});
+
+	/* prefix sums: chunks * chunks values, no need to go parallel */
+	bucket_start.assign(chunks + 1, 0);
+	for (int b = 0; b < chunks; ++b) {
+		int offset = bucket_start[b];
+		for (int t = 0; t < chunks; ++t) {
+			int count = histograms[t][b];
+			histograms[t][b] = offset;
+			offset += count;
+		}
+		bucket_start[b + 1] = offset;
+	}
+
+	/* stable scatter of particle indices into buckets */
+	pool.run(chunks, [&] (int t, int) {
+		std::vector<int> &offset = histograms[t];
+		int end = chunk_begin(t + 1, amount, chunks);
+		int bucket = 0;
+		for (int i = chunk_begin(t, amount, chunks); i < end; ++i) {
+			int cx = cells_arg[i] / ycells;
+			while (cx < column_begin[bucket])
+				--bucket;
+			while (cx >= column_begin[bucket + 1])
+				++bucket;
+			staged[offset[bucket]++] = i;
+		}
+	});
+
+	cell_sum.resize(xcells * ycells);
+	cell_count.resize(xcells * ycells);
+	pool.run(chunks, [&] (int b, int) { link_bucket(b); });
+	cell_sums_valid = true;
+	rebuild_cells = NULL;
+
+	int changes = 0;
+	for (int t = 0; t < chunks; ++t)
+		changes += chunk_changes[t];
+	return changes;
+}
+
+/**
+ * link_bucket - links particles of bucket @bucket into lists
+ * of their cells in ascending order of ids; columns of the bucket
+ * are touched by the calling thread only
+ */
+void Grid::link_bucket(int bucket)
+{
+	const int first_cell = column_begin[bucket] * ycells;
+	const int last_cell = column_begin[bucket + 1] * ycells;
+	for (int c = first_cell; c < last_cell; ++c) {
+		cells[c / ycells][c % ycells] = NULL;
+		cell_count[c] = 0;
+		cell_sum[c] = Point(0, 0);
+	}
+	for (int x = column_begin[bucket]; x < column_begin[bucket + 1]; ++x) {
+		column_occupied[x] = 0;
+		std::fill(occupancy.begin() + x * column_words,
+			occupancy.begin() + (x + 1) * column_words, 0);
+	}
+	/* backwards, so that pushing to head gives ascending order */
+	for (int k = bucket_start[bucket + 1] - 1; k >= bucket_start[bucket]; --k) {
+		int i = staged[k];
+		int c = (*rebuild_cells)[i];
+		link_unchecked(by_id[i], c / ycells, c % ycells);
+	}
+	for (int c = first_cell; c < last_cell; ++c) {
+		Point sum(0, 0);
+		int count = 0;
+		for (Particle *p = cells[c / ycells][c % ycells]; p != NULL;
+				p = p->next) {
+			const Point &v = (*velocities)[p->get_id()];
+			sum._x += v._x;
+			sum._y += v._y;
+			++count;
+		}
+		cell_sum[c] = sum;
+		cell_count[c] = count;
+	}
+}
+
+bool Grid::cell_covered(int gx, int gy,
+	double cx, double cy, double r2) const
+{
+	double x = gx * cell_xsize - cx,
+		   y = gy * cell_ysize - cy;
+	double far_x = std::max(square(x), square(x + cell_xsize));
+	double far_y = std::max(square(y), square(y + cell_ysize));
+	return far_x + far_y < r2;
+}
+
 inline int Grid::get_used(int x, int y)
 {
 	return used[y * xcells + x];
@@ -134,8 +367,8 @@ inline void Grid::set_used(int x, int y, int val)
 	used[y * xcells + x] = val;
 }
 
-const Point Grid::get_cell_speed(Particle *head,
-	double cx, double cy, double r2)
+const Point Grid::get_cell_speed(const Particle *head,
+	double cx, double cy, double r2, int &found) const
 {
 	Point v(0, 0);
 	while (head != NULL) {
@@ -143,35 +376,277 @@ const Point Grid::get_cell_speed(Particle *head,
 		double y = head->get_y() - cy;
 		if (square(x) + square(y) < r2) {
 			v = v + get_particle_speed(head);
-			++found_particles;
+			++found;
 		}
 		head = head->next;
 	}
 	return v;
 }
 
+const Point Grid::get_cell_speed(int gx, int gy,
+	double cx, double cy, double r2, int &found) const
+{
+	int cell = gx * ycells + gy;
+	const Particle *head = cells[gx][gy];
+	if (head == NULL)
+		return Point(0, 0);
+	/* for a lone particle its own check is not more expensive */
+	if (cell_count[cell] > 1 && cell_covered(gx, gy, cx, cy, r2)) {
+		found += cell_count[cell];
+		return cell_sum[cell];
+	}
+	PROFILE_COUNT(cnt_boundary_cells, 1);
+	return get_cell_speed(head, cx, cy, r2, found);
+}
+
 const Point &Grid::get_particle_speed(const Particle *particle) const
 {
 	return (*velocities)[particle->get_id()];
 }
 
+template<typename Visit>
+void Grid::for_occupied(int gx, int from, int to, const Visit &visit) const
+{
+	const uint64_t *column = &occupancy[gx * column_words];
+	for (int word = from >> 6; word <= (to >> 6); ++word) {
+		uint64_t bits = column[word];
+		if (word == (from >> 6))
+			bits &= ~0ULL << (from & 63);
+		if (word == (to >> 6) && (to & 63) != 63)
+			bits &= (1ULL << ((to & 63) + 1)) - 1;
+		while (bits != 0) {
+			int gy = (word << 6) + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			PROFILE_COUNT(cnt_cells_visited, 1);
+			visit(gy);
+		}
+	}
+}
+
+void Grid::cell_indices(const Point *positions, int count, int *cells) const
+{
+	Kernels::cell_indices(positions, count, cell_xsize, cell_ysize,
+		xcells, ycells, cells);
+}
+
+void Grid::set_fixed_positions(const std::vector<FixedPoint> *positions,
+	const FixedFrame &frame_arg)
+{
+	assert(positions == NULL || xsize == ysize);
+	fixed_positions = positions;
+	frame = frame_arg;
+}
+
+const Point Grid::get_cell_speed(int gx, int gy, double cx, double cy,
+	const FixedPoint &center, double r2, int &found) const
+{
+	int cell = gx * ycells + gy;
+	if (cell_count[cell] > 1 && cell_covered(gx, gy, cx, cy, r2)) {
+		found += cell_count[cell];
+		return cell_sum[cell];
+	}
+	PROFILE_COUNT(cnt_boundary_cells, 1);
+	const std::vector<FixedPoint> &fixed = *fixed_positions;
+	Point v(0, 0);
+	for (const Particle *p = cells[gx][gy]; p != NULL; p = p->next) {
+		if (frame.distance2(fixed[p->get_id()], center) < r2) {
+			v = v + get_particle_speed(p);
+			++found;
+		}
+	}
+	return v;
+}
+
+Point Grid::scan_column(int gx, int from, int to,
+	double cx, double cy, double r2, int &found) const
+{
+	Point v(0, 0);
+	for_occupied(gx, from, to, [&] (int gy) {
+		v = v + get_cell_speed(gx, gy, cx, cy, r2, found);
+	});
+	return v;
+}
+
+/**
+ * Disc is covered by columns of cells; in each column only rows
+ * crossed by the disc are scanned (@visit gets column, range of
+ * rows and virtual center of disc for them). Disc must be narrower
+ * than the area, so that no particle can be in disc around two
+ * virtual centers at once.
+ */
+template<typename Visit>
+void Grid::for_disc_columns(double cx, double cy, double r2,
+	const Visit &visit) const
+{
+	int cellx = get_cell_x(cx);
+	int reach = (int) (sqrt(r2) / cell_xsize) + 1;
+	for (int gx = cellx - reach; gx <= cellx + reach; ++gx) {
+		int nx = gx;
+		double ncx = cx;
+		if (nx < 0) {
+			nx += xcells;
+			ncx += xsize;
+		} else if (nx >= xcells) {
+			nx -= xcells;
+			ncx -= xsize;
+		}
+		if (column_occupied[nx] == 0)
+			continue;
+		double left = nx * cell_xsize - ncx;
+		double right = left + cell_xsize;
+		double dx = left > 0 ? left : (right < 0 ? -right : 0);
+		if (square(dx) >= r2)
+			continue;
+		double half = sqrt(r2 - square(dx));
+		int from = (int) floor((cy - half) / cell_ysize);
+		int to = (int) floor((cy + half) / cell_ysize);
+		if (from < 0) {
+			visit(nx, from + ycells, ycells - 1, ncx, cy + ysize);
+			from = 0;
+		}
+		if (to >= ycells) {
+			visit(nx, 0, to - ycells, ncx, cy - ysize);
+			to = ycells - 1;
+		}
+		visit(nx, from, to, ncx, cy);
+	}
+}
+
+/**
+ * Only non-empty cells of columns crossed by the disc are visited
+ * thanks to occupancy bitmap, see for_disc_columns
+ */
 Point Grid::get_disc_speed(const Particle &particle, double radius)
+{
+	if (2 * radius >= std::min(xsize, ysize))
+		return get_disc_speed_bfs(particle, radius);
+	if (!cell_sums_valid)
+		update_cell_sums();
+	return get_disc_speed(particle, radius, found_particles);
+}
+
+Point Grid::get_disc_speed(const Particle &particle, double radius,
+	int &found) const
+{
+	assert(2 * radius < std::min(xsize, ysize));
+	assert(cell_sums_valid);
+	double r2 = square(radius);
+	double cx = particle.get_x();
+	double cy = particle.get_y();
+
+	found = 0;
+	Point v(0, 0);
+	if (fixed_positions != NULL) {
+		/* minimum image distances, virtual centers only pick cells */
+		const FixedPoint &center = (*fixed_positions)[particle.get_id()];
+		for_disc_columns(cx, cy, r2, [&] (int gx, int from, int to,
+				double ncx, double ncy) {
+			Point column(0, 0);
+			for_occupied(gx, from, to, [&] (int gy) {
+				column = column + get_cell_speed(gx, gy, ncx, ncy,
+					center, r2, found);
+			});
+			v = v + column;
+		});
+	} else {
+		for_disc_columns(cx, cy, r2, [&] (int gx, int from, int to,
+				double ncx, double ncy) {
+			v = v + scan_column(gx, from, to, ncx, ncy, r2, found);
+		});
+	}
+	PROFILE_COUNT(cnt_queries, 1);
+	PROFILE_COUNT(cnt_neighbours, found > 0 ? found - 1 : 0);
+	if (found <= 1)
+		return Point(0, 0);
+	return (v - get_particle_speed(&particle)) / (found - 1);
+}
+
+/**
+ * A cell lying in one ring completely goes to it as a whole,
+ * otherwise each particle goes to the ring of its distance
+ */
+void Grid::add_to_rings(int gx, int gy, double cx, double cy,
+	const double *r2, int k, Point *sums, int *counts) const
+{
+	int cell = gx * ycells + gy;
+	if (cell_count[cell] > 1) {
+		double x = gx * cell_xsize - cx,
+			   y = gy * cell_ysize - cy;
+		double far = std::max(square(x), square(x + cell_xsize)) +
+			std::max(square(y), square(y + cell_ysize));
+		double near_x = x > 0 ? x : std::max(0.0, -(x + cell_xsize));
+		double near_y = y > 0 ? y : std::max(0.0, -(y + cell_ysize));
+		double near = square(near_x) + square(near_y);
+		int j = 0;
+		while (j < k && far >= r2[j])
+			++j;
+		if (j < k && (j == 0 || near >= r2[j - 1])) {
+			sums[j] = sums[j] + cell_sum[cell];
+			counts[j] += cell_count[cell];
+			return;
+		}
+	}
+	PROFILE_COUNT(cnt_boundary_cells, 1);
+	for (const Particle *p = cells[gx][gy]; p != NULL; p = p->next) {
+		double d2 = square(p->get_x() - cx) + square(p->get_y() - cy);
+		for (int j = 0; j < k; ++j) {
+			if (d2 < r2[j]) {
+				sums[j] = sums[j] + get_particle_speed(p);
+				++counts[j];
+				break;
+			}
+		}
+	}
+}
+
+void Grid::get_disc_speeds(const Particle &particle,
+	const std::vector<double> &radii, Point *sums, int *counts) const
+{
+	const int k = (int) radii.size();
+	assert(k > 0 && k <= max_radii);
+	assert(2 * radii[k - 1] < std::min(xsize, ysize));
+	assert(cell_sums_valid);
+	double r2[max_radii];
+	for (int j = 0; j < k; ++j) {
+		assert(j == 0 || radii[j - 1] < radii[j]);
+		r2[j] = square(radii[j]);
+		sums[j] = Point(0, 0);
+		counts[j] = 0;
+	}
+	/* rings [r_{j-1}, r_j) first */
+	for_disc_columns(particle.get_x(), particle.get_y(), r2[k - 1],
+		[&] (int gx, int from, int to, double ncx, double ncy) {
+			for_occupied(gx, from, to, [&] (int gy) {
+				add_to_rings(gx, gy, ncx, ncy, r2, k, sums, counts);
+			});
+		});
+	for (int j = 1; j < k; ++j) {
+		sums[j] = sums[j] + sums[j - 1];
+		counts[j] += counts[j - 1];
+	}
+	PROFILE_COUNT(cnt_queries, 1);
+}
+
+Point Grid::get_disc_speed_bfs(const Particle &particle, double radius)
 {
 	double r2 = square(radius);
 	double cx = particle.get_x();
 	double cy = particle.get_y();
 
-	int cellx = (int) (cx / cell_xsize);
-	int celly = (int) (cy / cell_ysize);
+	int cellx = get_cell_x(cx);
+	int celly = get_cell_y(cy);
 
 	assert(q.empty());
 	assert(centers.empty());
+	if (!cell_sums_valid)
+		update_cell_sums();
 	q.push(std::make_pair(cellx, celly));
 	centers.push(std::make_pair(cx, cy));
 
 	found_particles = 0;
-	Point v = get_cell_speed(cells[cellx][celly], cx, cy, r2);
+	Point v = get_cell_speed(cellx, celly, cx, cy, r2, found_particles);
 	set_used(cellx, celly, time_cnt);
+	PROFILE_COUNT(cnt_cells_visited, 1);
 	while (!q.empty()) {
 		std::pair<int, int> next = q.front();
 		std::pair<double, double> cur_center = centers.front();
@@ -201,17 +676,30 @@ Point Grid::get_disc_speed(const Particle &particle, double radius)
 			if (!cell_in_disc(nx, ny, ncx, ncy, r2))
 				continue;
 			set_used(nx, ny, time_cnt);
+			PROFILE_COUNT(cnt_cells_visited, 1);
 			q.push(std::make_pair(nx, ny));
 			centers.push(std::make_pair(ncx, ncy));
-			v = v + get_cell_speed(cells[nx][ny], ncx, ncy, r2);
+			v = v + get_cell_speed(nx, ny, ncx, ncy, r2, found_particles);
 		}
 	}
 	++time_cnt;
+	PROFILE_COUNT(cnt_queries, 1);
+	PROFILE_COUNT(cnt_neighbours, particles_in_disc());
 	if (found_particles <= 1)
 		return Point(0, 0);
 	return (v - get_particle_speed(&particle)) / (found_particles - 1);
 }
 
+void Grid::place_memory(ThreadPool &pool, int particles, bool huge_pages)
+{
+	first_touch(by_id, particles, pool, huge_pages, (Particle *) NULL);
+	first_touch(cell_of, particles, pool, huge_pages, -1);
+	first_touch(new_cells, particles, pool, huge_pages);
+	first_touch(cell_sum, xcells * ycells, pool, huge_pages);
+	first_touch(cell_count, xcells * ycells, pool, huge_pages);
+	cell_sums_valid = false;
+}
+
 int Grid::particles_in_disc() const {
 	return found_particles > 0 ? found_particles - 1 : 0;
 }
@@ -0,0 +1,54 @@
+#ifndef __SSU_KMY_AUTOTUNER_H_
+#define __SSU_KMY_AUTOTUNER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <functional>
+#include "types.h"
+
+/* performance parameters of the parallel engine, see Cluster */
+struct TuningParams {
+	int cells_per_epsilon;
+	int threads;
+	/* 0 means default tiles */
+	int tile_cells;
+	int reorder_interval;
+};
+
+/**
+ * Search for the fastest TuningParams and their store: tuning file
+ * has a line per key (CPU model and class of the system, see @key),
+ * so a machine keeps the best parameters for each kind of system
+ */
+class Autotuner
+{
+public:
+	/* benchmark of parameters, @returns seconds per particle-step */
+	typedef std::function<double (const TuningParams &)> benchmark_t;
+
+	explicit Autotuner(const char *file_name);
+	/**
+	 * key - CPU model and number of hardware threads, powers of 2
+	 * closest to @N, expected neighbours in disc of @epsilon and
+	 * @L / @epsilon: systems of one class run best alike
+	 */
+	static std::string key(int N, ld L, ld epsilon);
+	/* @returns true and fills @params if @key is in the file */
+	bool load(const std::string &key, TuningParams &params) const;
+	/* replaces line of @key in the file, @returns false on failure */
+	bool store(const std::string &key, const TuningParams &params) const;
+	/**
+	 * tune - coordinate search from @start: each parameter in turn
+	 * takes the fastest of its candidates, others being fixed;
+	 * the best of 2 runs of @benchmark counts, progress goes to @out
+	 */
+	TuningParams tune(const TuningParams &start, int max_threads,
+		const benchmark_t &benchmark, FILE *out) const;
+private:
+	std::string file_name;
+
+	static std::string cpu_model();
+};
+
+#endif /* __SSU_KMY_AUTOTUNER_H_ */
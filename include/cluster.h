@@ -6,7 +6,14 @@
 #include <vector>
 #include "point.h"
 #include "grid.h"
+#include "mesh.h"
 #include "gaussian_gen.h"
+#include "model.h"
+#include "stream_gen.h"
+#include "noise_buffer.h"
+#include "thread_pool.h"
+#include "reduction.h"
+#include "tile_scheduler.h"
 
 typedef Point (*speed_integrator)(Point, Point);
 typedef Point (*position_integrator)(Point, Point);
@@ -31,7 +38,27 @@ public:
 			const ld& speed_highest);
 	void seed_uniformly(const ld &speed_lowest,
 			const ld &speed_highest);
+	/**
+	 * the same as @seed_uniformly, but from @noise_gen instead of
+	 * global ran3: reproducible and safe for several clusters at once
+	 */
+	void seed_from_noise(const ld &speed_lowest,
+			const ld &speed_highest);
 	void evolve(speed_integrator, position_integrator);
+	/**
+	 * evolve_global - fused step for global visibility:
+	 * integrates all particles in one pass with @model and
+	 * noise from @noise_gen, accumulating mean velocity of
+	 * the next state by fixed blocks on the way
+	 */
+	void evolve_global();
+	/**
+	 * evolve_parallel - step integrated with @model and noise
+	 * from @noise_gen on all threads of the cluster:
+	 * by evolve_global for global visibility, by spatial tiles
+	 * of the grid otherwise (requires grid to be used)
+	 */
+	void evolve_parallel();
 	void init_log(const char *log_file);
 	void exit_log();
 	void log_positions();
@@ -40,7 +67,78 @@ public:
 	ld get_measurement() const;
 
 	ld get_avg_speed_val() const;
+	/* mean fraction of particles changing grid cell per step */
+	ld get_crosser_fraction() const;
 	void use_grid(bool yes);
+	/**
+	 * use_mesh - approximate alignment field on mesh
+	 * of @cells x @cells (see Mesh), 0 turns it off;
+	 * takes precedence over grid and naive approaches
+	 */
+	void use_mesh(int cells);
+	/**
+	 * report_mesh_error - compares mesh approximation with
+	 * exact Grid::get_disc_speed on about @samples particles
+	 */
+	void report_mesh_error(FILE *out, int samples);
+	/**
+	 * report_local_order - for each of ascending @radii mean over
+	 * particles of |mean velocity in disc| and of number of
+	 * neighbours, all radii in one pass (Grid::get_disc_speeds)
+	 */
+	void report_local_order(FILE *out, const std::vector<ld> &radii);
+	void set_model(const Model &model);
+	void set_threads(int threads);
+	void set_noise_seed(uint64_t seed);
+	/**
+	 * every @steps steps particles are renumbered in Morton order
+	 * of their positions, so that spatial neighbours are close
+	 * in memory as well; 0 turns it off. Noise of parallel engines
+	 * follows particles, but sums are taken in the new order, so
+	 * results agree up to rounding only
+	 */
+	void set_reorder_interval(int steps);
+	/**
+	 * set_noise_buffer - noise for parallel engines is generated
+	 * @steps steps ahead by a background thread (see NoiseBuffer),
+	 * 0 turns it off; doesn't change results
+	 */
+	void set_noise_buffer(int steps);
+	/* fraction of steps, that had to wait for buffered noise */
+	ld get_noise_underrun_fraction() const;
+	/**
+	 * parallel engines estimate local error of each step,
+	 * if @yes: RMS over particles of distance between Heun
+	 * velocity and its Euler predictor, see @get_step_error
+	 */
+	void set_error_estimate(bool yes);
+	ld get_step_error() const;
+	/**
+	 * tiled step keeps positions as 32-bit fractions of L
+	 * (see FixedFrame), if @yes: wrap by overflow, cells by
+	 * multiplication and minimum image distances in the grid;
+	 * positions are rounded to L / 2^32
+	 */
+	void set_fixed_positions(bool yes);
+	/**
+	 * set_grid_resolution - grid has @cells_per_epsilon cells
+	 * per @epsilon along each side (5 by default); reinits
+	 */
+	void set_grid_resolution(int cells_per_epsilon);
+	/**
+	 * set_tile_cells - tiles of tiled step are @cells x @cells
+	 * cells of the grid; 0 means 64 x 64 tiles at most (default)
+	 */
+	void set_tile_cells(int cells);
+	/**
+	 * set_placement - threads are pinned to @cpus (see
+	 * ThreadPool::pin); state, cell and noise arrays are first
+	 * touched at seeding by the threads, which work on them, so
+	 * they're on their NUMA nodes, on huge pages if @huge_pages;
+	 * empty @cpus turns it off, so does set_threads;
+	 * @returns false (and it's off) if threads can't be pinned
+	 */
+	bool set_placement(const std::vector<int> &cpus, bool huge_pages);
 private:
 	int N;
 	ld L;
@@ -54,11 +152,12 @@ private:
 	FILE *log;
 	char buffer[128];
 	bool measurement;
-	ld avg_speed;
+	KahanSum avg_speed;
 	int avg_denominator;
 
 	Point get_mean_field_speed(int particleId);
 	Point get_disc_speed_with_grid(int particleId);
+	Point get_disc_speed_with_mesh(int particleId);
 	Point get_avg_speed() const;
 
 	std::vector<Point> &get_cur_coordinates();
@@ -67,13 +166,93 @@ private:
 	std::vector<Point> &get_next_velocities();
 	void swap_states();
 	void update_grid();
+	/* same as update_grid, but builds grid on all threads of @pool */
+	void update_grid_parallel();
 
 	Grid *grid;
 	bool grid_updated;
+	long long crossers;
+	int crosser_updates;
 	std::vector<Particle *> particles;
 
 	int particles_found_naive;
 	bool calculate_with_grid;
+
+	Mesh *mesh;
+	int mesh_cells;
+	bool mesh_updated;
+
+	Model model;
+	StreamGen noise_gen;
+	/* number of steps made since reinit, keys the noise */
+	uint64_t step;
+	ThreadPool *pool;
+	NoiseBuffer *noise_buffer;
+	int noise_buffer_steps;
+	/* noise of current step from @noise_buffer, nullptr if it's off */
+	const Noise *acquire_noise();
+	void release_noise();
+	/**
+	 * @block_sums - velocity sums over blocks of @reduction_block
+	 * particles; block bounds don't depend on amount of threads,
+	 * so the reduced @next_avg_speed doesn't as well
+	 */
+	mutable std::vector<PointSum> block_sums;
+	Point next_avg_speed;
+	bool next_avg_known;
+	Point reduce_block_sums() const;
+	/* squared local errors by blocks (or tiles) of particles */
+	bool estimate_error;
+	std::vector<KahanSum> error_sums;
+	ld step_error;
+	void reduce_error_sums();
+
+	/**
+	 * state of particle with stable id @id is kept at @slot_of[id],
+	 * @ids[slot] is the inverse; both are identity until reorder
+	 */
+	std::vector<int> ids;
+	std::vector<int> slot_of;
+	int reorder_interval;
+	bool grid_rebuild;
+	void reorder_particles();
+
+	/**
+	 * tiled stepping: particles are binned into @tiles_per_side^2
+	 * spatial tiles, cost of a tile is estimated by neighbours found
+	 * for its particles at the previous step (@neighbour_count)
+	 */
+	int tiles_per_side;
+	int tile_cells;
+	int cells_per_epsilon;
+	std::vector<int> placement_cpus;
+	bool huge_pages;
+	void place_memory();
+	std::vector<int> neighbour_count;
+	std::vector<int> tile_start;
+	std::vector<int> tile_members;
+	std::vector<double> tile_cost;
+	TileScheduler scheduler;
+	/* sums of next velocities by tiles, for the order parameter */
+	std::vector<PointSum> tile_sums;
+	/**
+	 * grid has @grid_cells x @grid_cells cells; @cur_cells are
+	 * cell indices of current positions (valid if @cur_cells_known),
+	 * @next_cells of next ones, filled during tiled step
+	 */
+	int grid_cells;
+	std::vector<int> cur_cells;
+	std::vector<int> next_cells;
+	bool cur_cells_known;
+	/* fixed-point positions, current ones are valid with @cur_cells */
+	bool fixed_positions;
+	FixedFrame frame;
+	std::vector<FixedPoint> cur_fixed;
+	std::vector<FixedPoint> next_fixed;
+	void find_cells();
+	void bin_into_tiles();
+	void evolve_tiled();
+	inline void wrap(Point &position) const;
 };
 
 #endif /* __SSU_KMY_CLUSTER_H_ */
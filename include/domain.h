@@ -0,0 +1,102 @@
+#ifndef __SSU_KMY_DOMAIN_H_
+#define __SSU_KMY_DOMAIN_H_
+
+#include <vector>
+#include <mpi.h>
+#include "point.h"
+#include "particle.h"
+#include "grid.h"
+#include "model.h"
+#include "stream_gen.h"
+#include "reduction.h"
+
+/**
+ * Distributed counterpart of Cluster with local visibility:
+ * the periodic LxL box is split along x into slabs, one per rank
+ * of @comm. A rank owns particles of its slab and, before each step,
+ * receives from its two neighbours copies of their particles lying
+ * within @epsilon of the common boundary (halo). After the step
+ * particles, that left the slab, migrate to the neighbour.
+ * Noise is keyed by stable ids as in Cluster::evolve_parallel,
+ * so results don't depend on number of ranks up to rounding
+ * of neighbour sums.
+ */
+class Domain
+{
+public:
+	Domain(MPI_Comm comm, int N, ld L, ld epsilon);
+	~Domain();
+	/**
+	 * seed_uniformly - positions uniformly in the box, velocity
+	 * components uniformly in [@speed_lowest, @speed_highest];
+	 * depends only on noise seed, not on ranks
+	 */
+	void seed_uniformly(ld speed_lowest, ld speed_highest);
+	void set_model(const Model &model);
+	void set_noise_seed(uint64_t seed);
+	void evolve();
+
+	void start_speed_measurement();
+	ld get_measurement() const;
+	/* order parameter of current state, collective call */
+	ld get_avg_speed_val() const;
+	/**
+	 * gather - positions and velocities of all particles by ids
+	 * are put to @r and @v on rank 0, collective call
+	 */
+	void gather(std::vector<Point> &r, std::vector<Point> &v) const;
+	int get_owned() const { return (int) ids.size(); }
+	int get_rank() const { return rank; }
+	int get_ranks() const { return ranks; }
+private:
+	MPI_Comm comm;
+	int rank;
+	int ranks;
+	int left;
+	int right;
+	int N;
+	ld L;
+	ld epsilon;
+	/* slab of the rank is [@x0, @x0 + @width) */
+	ld x0;
+	ld width;
+
+	/**
+	 * owned particles come first in @r, @v, @ids, halo copies
+	 * are appended to @r and @v before each step
+	 */
+	std::vector<Point> r;
+	std::vector<Point> v;
+	std::vector<int> ids;
+	std::vector<Point> rnext;
+	std::vector<Point> vnext;
+
+	/* grid over the slab with halos, x shifted by @x0 - @epsilon */
+	Grid *grid;
+	std::vector<Particle *> particles;
+
+	Model model;
+	StreamGen noise_gen;
+	uint64_t step;
+	bool measurement;
+	KahanSum avg_speed;
+	int avg_denominator;
+
+	/* particle is packed to @record_size doubles: x, y, vx, vy, id */
+	static const int record_size = 5;
+	std::vector<double> to_left;
+	std::vector<double> to_right;
+	std::vector<double> from_left;
+	std::vector<double> from_right;
+
+	void pack(std::vector<double> &buffer, int i) const;
+	/* sends @to_left and @to_right, receives @from_right, @from_left */
+	void exchange();
+	void exchange_halo();
+	void migrate();
+	void build_grid();
+	Point get_sum_speed() const;
+	inline void wrap(Point &p) const;
+};
+
+#endif /* __SSU_KMY_DOMAIN_H_ */
@@ -0,0 +1,75 @@
+#ifndef __SSU_KMY_FIXED_POINT_H_
+#define __SSU_KMY_FIXED_POINT_H_
+
+#include <stdint.h>
+#include <cmath>
+#include "point.h"
+
+/* position in a square as unsigned 32-bit fractions of its side */
+struct FixedPoint {
+	uint32_t x;
+	uint32_t y;
+};
+
+/**
+ * Conversions between Point and FixedPoint in square of side @L:
+ * periodic wrap is overflow of uint32_t, difference of positions
+ * cast to int32_t is the minimum image one, and cell of @cells
+ * along an axis is (coordinate * @cells) >> 32, always in range.
+ * Resolution is @L / 2^32, conversion of a FixedPoint to Point
+ * and back is exact.
+ */
+class FixedFrame
+{
+public:
+	explicit FixedFrame(ld L = 1) :
+		L(L), scale(4294967296.0 / L), unit(L / 4294967296.0) {}
+	/* @p may be out of the square, it's wrapped */
+	FixedPoint to_fixed(const Point &p) const
+	{
+		FixedPoint result = { coordinate(p._x), coordinate(p._y) };
+		return result;
+	}
+	Point to_point(const FixedPoint &p) const
+	{
+		return Point(p.x * unit, p.y * unit);
+	}
+	/* @p moved by @d, which must be shorter than @L / 2 */
+	FixedPoint advance(const FixedPoint &p, const Point &d) const
+	{
+		FixedPoint result = { p.x + offset(d._x), p.y + offset(d._y) };
+		return result;
+	}
+	/* minimum image of @a - @b */
+	Point difference(const FixedPoint &a, const FixedPoint &b) const
+	{
+		return Point((int32_t) (a.x - b.x) * unit,
+			(int32_t) (a.y - b.y) * unit);
+	}
+	ld distance2(const FixedPoint &a, const FixedPoint &b) const
+	{
+		ld dx = (int32_t) (a.x - b.x) * unit;
+		ld dy = (int32_t) (a.y - b.y) * unit;
+		return dx * dx + dy * dy;
+	}
+	static int cell(uint32_t coordinate, int cells)
+	{
+		return (int) (((uint64_t) coordinate * (uint32_t) cells) >> 32);
+	}
+private:
+	ld L;
+	ld scale;
+	ld unit;
+
+	uint32_t coordinate(ld x) const
+	{
+		/* 2^32 rounded up from just below L wraps to 0 */
+		return (uint32_t) llround((x - L * floor(x / L)) * scale);
+	}
+	uint32_t offset(ld d) const
+	{
+		return (uint32_t) (int32_t) llround(d * scale);
+	}
+};
+
+#endif /* __SSU_KMY_FIXED_POINT_H_ */
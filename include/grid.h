@@ -8,9 +8,14 @@
 
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <cassert>
 #include <memory.h>
+#include <stdint.h>
 #include "particle.h"
+#include "thread_pool.h"
+#include "fixed_point.h"
+#include "kernels.h"
 
 class Grid {
 public:
@@ -18,6 +23,8 @@ public:
 		int xcells, int ycells);
 	~Grid();
 	void add(Particle *particle);
+	/* removes all particles from the grid */
+	void clear();
 	void update_for_search(std::vector<Point> *velocities);	
 	
 	/**
@@ -29,9 +36,81 @@ public:
 	 */
 	void move(Particle *particle, double nx, double ny);
 	void move(Particle *particle, Point &next_pos);
+	/**
+	 * update_positions - moves all particles at once to @positions
+	 * (indexed by Particle's @id); cell indices are computed for
+	 * all particles in a separate branch-free pass and compared
+	 * to cached ones, so only particles crossing cell boundaries
+	 * are relinked
+	 * @returns number of particles, that changed their cells
+	 */
+	int update_positions(const std::vector<Point> &positions);
 
 	Point get_disc_speed(const Particle &particle, double radius);
+	/**
+	 * const variant of @get_disc_speed, safe to be called
+	 * from several threads at once; @found gets number of
+	 * particles in disc (including @particle itself).
+	 * Requires 2 * @radius to be less than sizes of the area
+	 * and update_cell_sums to be called after grid changes
+	 */
+	Point get_disc_speed(const Particle &particle, double radius,
+		int &found) const;
+	/* most radii get_disc_speeds takes at once */
+	static const int max_radii = 16;
+	/**
+	 * get_disc_speeds - @get_disc_speed for several radii in one
+	 * pass over neighbours: @sums[j] and @counts[j] get sum of
+	 * velocities and number of particles (including @particle
+	 * itself) in disc of @radii[j]; @radii must be ascending,
+	 * the largest one is bound as in @get_disc_speed
+	 */
+	void get_disc_speeds(const Particle &particle,
+		const std::vector<double> &radii, Point *sums,
+		int *counts) const;
+	void update_cell_sums();
+	/**
+	 * rebuild - builds the grid from scratch for particles, that are
+	 * already in it, moved to @positions, on all threads of @pool;
+	 * also does what update_for_search(@velocities_p) and
+	 * update_cell_sums do. Order of particles in cells doesn't
+	 * depend on number of threads.
+	 * @returns number of particles, that changed their cells
+	 */
+	int rebuild(const std::vector<Point> &positions,
+		std::vector<Point> *velocities_p, ThreadPool &pool);
+	/* the same, but with cell indices of @positions known already */
+	int rebuild(const std::vector<Point> &positions,
+		const std::vector<int> &cells,
+		std::vector<Point> *velocities_p, ThreadPool &pool);
+	/* index (x * ycells + y) of the cell, containing @position */
+	int cell_index(const Point &position) const
+	{
+		return get_cell_x(position._x) * ycells + get_cell_y(position._y);
+	}
+	/* @cell_index of @count @positions at once, vectorised */
+	void cell_indices(const Point *positions, int count, int *cells) const;
+	/* the same for fixed-point @position in square area */
+	int cell_index(const FixedPoint &position) const
+	{
+		return FixedFrame::cell(position.x, xcells) * ycells +
+			FixedFrame::cell(position.y, ycells);
+	}
+	/**
+	 * set_fixed_positions - const @get_disc_speed takes distances
+	 * as minimum images of @positions (by Particle's @id) in
+	 * @frame of square area instead of Particle's coordinates,
+	 * which still choose cells to visit; NULL turns it off
+	 */
+	void set_fixed_positions(const std::vector<FixedPoint> *positions,
+		const FixedFrame &frame);
 	int particles_in_disc() const;
+	/**
+	 * place_memory - arrays by particle id (for @particles ids)
+	 * and by cell are first touched by threads of @pool, see
+	 * first_touch; the grid must be empty
+	 */
+	void place_memory(ThreadPool &pool, int particles, bool huge_pages);
 	void dump_grid(const char *file_name);
 private:
 	/* spatial sizes of area under grid */
@@ -47,6 +126,63 @@ private:
 	std::vector<std::vector<Particle*> > cells;
 	/* velocities of particles, connection via Particle's @id */
 	std::vector<Point> *velocities;
+	/* particles and indices of their cells (x * ycells + y) by @id */
+	std::vector<Particle *> by_id;
+	std::vector<int> cell_of;
+	/* scratch for update_positions and rebuild */
+	std::vector<int> new_cells;
+	/**
+	 * scratch for rebuild: particles are first partitioned
+	 * into buckets of columns, @histograms[t][b] is the number
+	 * of particles of chunk @t in bucket @b
+	 */
+	std::vector<std::vector<int> > histograms;
+	std::vector<int> bucket_start;
+	std::vector<int> column_begin;
+	std::vector<int> staged;
+	std::vector<int> chunk_changes;
+	/* cell indices, rebuild is called with */
+	const std::vector<int> *rebuild_cells;
+	void link_bucket(int bucket);
+	/**
+	 * sums of velocities and numbers of particles by cells,
+	 * rebuilt lazily after any change of grid or velocities;
+	 * cells lying completely inside of the disc are summed up
+	 * without visiting particles
+	 */
+	std::vector<Point> cell_sum;
+	std::vector<int> cell_count;
+	bool cell_sums_valid;
+
+	/**
+	 * occupancy bitmap: bit y of column x is set iff cells[x][y]
+	 * is not empty, each column takes @column_words words;
+	 * @column_occupied[x] - number of non-empty cells in column x
+	 */
+	int column_words;
+	std::vector<uint64_t> occupancy;
+	std::vector<int> column_occupied;
+	/**
+	 * scan_column - sums up velocities of particles in disc
+	 * (@cx, @cy, @r2) from non-empty cells of column @gx
+	 * with rows in [@from, @to], visiting only set bits
+	 */
+	Point scan_column(int gx, int from, int to,
+		double cx, double cy, double r2, int &found) const;
+	/* calls @visit(gy) for non-empty cells of column @gx in [@from, @to] */
+	template<typename Visit>
+	void for_occupied(int gx, int from, int to, const Visit &visit) const;
+	template<typename Visit>
+	void for_disc_columns(double cx, double cy, double r2,
+		const Visit &visit) const;
+	/**
+	 * add_to_rings - particles of cell (@gx, @gy) in rings between
+	 * squared radii @r2 around (@cx, @cy) to @sums and @counts
+	 */
+	void add_to_rings(int gx, int gy, double cx, double cy,
+		const double *r2, int k, Point *sums, int *counts) const;
+	/* search by BFS over cells, works for any radius */
+	Point get_disc_speed_bfs(const Particle &particle, double radius);
 
 	/**
 	 * @q and @used are for BFS
@@ -76,15 +212,46 @@ private:
 	 */
 	bool cell_in_disc(int gx, int gy,
 		double cx, double cy, double r2) const;
+	/* cell_covered - check if all 4 angles of the cell are in the disc */
+	bool cell_covered(int gx, int gy,
+		double cx, double cy, double r2) const;
+	/**
+	 * cell coordinates of spatial ones, clamped to the grid:
+	 * wrapped coordinate may happen to be exactly @xsize (@ysize)
+	 */
+	int get_cell_x(double x) const
+	{
+		int cell_x = (int) (x / cell_xsize);
+		return cell_x < 0 ? 0 : (cell_x >= xcells ? xcells - 1 : cell_x);
+	}
+	int get_cell_y(double y) const
+	{
+		int cell_y = (int) (y / cell_ysize);
+		return cell_y < 0 ? 0 : (cell_y >= ycells ? ycells - 1 : cell_y);
+	}
+	void link(Particle *particle, int cell_x, int cell_y);
+	/**
+	 * link_unchecked - link without invalidating cell sums, for
+	 * threads of parallel rebuild, which makes them valid itself
+	 */
+	void link_unchecked(Particle *particle, int cell_x, int cell_y);
+	void unlink(Particle *particle, int cell_x, int cell_y);
 	inline int get_used(int x, int y);
 	inline void set_used(int x, int y, int val);
 	/**
 	 * @get_cell_speed - sums up velocities of particles in list @head,
 	 * if they are in disc with params @cx, @cy, @r2
 	 */
-	const Point get_cell_speed(Particle *head,
-		double cx, double cy, double r2);
+	const Point get_cell_speed(const Particle *head,
+		double cx, double cy, double r2, int &found) const;
+	const Point get_cell_speed(int gx, int gy,
+		double cx, double cy, double r2, int &found) const;
 	const Point &get_particle_speed(const Particle *particle) const;
+	/* the same as above, but by minimum image distance to @center */
+	const Point get_cell_speed(int gx, int gy, double cx, double cy,
+		const FixedPoint &center, double r2, int &found) const;
+	const std::vector<FixedPoint> *fixed_positions;
+	FixedFrame frame;
 };
 
 #endif /* __SSU_KMY_GRID_H_ */
\ No newline at end of file
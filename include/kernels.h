@@ -0,0 +1,51 @@
+#ifndef __SSU_KMY_KERNELS_H_
+#define __SSU_KMY_KERNELS_H_
+
+#include <stdint.h>
+#include "point.h"
+#include "model.h"
+
+/* instruction sets kernels are compiled for, in order of preference */
+enum isa_id {
+	isa_sse2,
+	isa_avx2,
+	isa_avx512,
+	isa_count
+};
+
+/**
+ * Array kernels compiled for every isa_id in one binary; the variant
+ * is chosen at run time, by default the best one the CPU supports.
+ * Variants differ only in vector width, so results are bitwise the
+ * same for any of them.
+ */
+class Kernels
+{
+public:
+	/* the best instruction set supported by this CPU */
+	static isa_id detect();
+	static bool supported(isa_id isa);
+	/* @isa must be supported */
+	static void select(isa_id isa);
+	static isa_id selected() { return isa; }
+	static const char *name(isa_id isa);
+	/* @returns false if @name is unknown */
+	static bool parse(const char *name, isa_id &isa);
+
+	/**
+	 * noise - the same as StreamGen::noise(@key, id, @xi + id - @first)
+	 * for ids in [@first, @first + @count)
+	 */
+	static void noise(uint64_t key, uint32_t first, int count, Noise *xi);
+	/**
+	 * cell_indices - x * @ycells + y, where x and y are cells
+	 * of @positions, as Grid computes them
+	 */
+	static void cell_indices(const Point *positions, int count,
+		double cell_xsize, double cell_ysize, int xcells, int ycells,
+		int *cells);
+private:
+	static isa_id isa;
+};
+
+#endif /* __SSU_KMY_KERNELS_H_ */
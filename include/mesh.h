@@ -0,0 +1,66 @@
+#ifndef __SSU_KMY_MESH_H_
+#define __SSU_KMY_MESH_H_
+
+#include <vector>
+#include "point.h"
+
+/**
+ * Approximate alignment field for large N (particle-mesh):
+ * velocities and particle counts are deposited onto @cells x @cells
+ * periodic mesh by cloud-in-cell (bilinear weights of 4 nearest nodes),
+ * the deposit is convolved once with the disc kernel (nodes within
+ * @radius of the node, summed by rows of periodic prefix sums),
+ * and the field is interpolated back to particles by the same weights.
+ * Cost per step is O(N + cells^2 * radius / cell size); the disc's
+ * edge is resolved to a cell, so error falls as the mesh gets finer
+ * (see Cluster::report_mesh_error).
+ */
+class Mesh {
+public:
+	Mesh(double size, int cells, double radius);
+	/* deposit and convolution, before any get_disc_speed */
+	void deposit(const std::vector<Point> &positions,
+			const std::vector<Point> &velocities);
+	/**
+	 * get_disc_speed - average velocity in disc around particle
+	 * at @position with velocity @velocity, particle itself excluded
+	 */
+	Point get_disc_speed(const Point &position, const Point &velocity) const;
+private:
+	double size;
+	int cells;
+	double cell_size;
+	/* @half_width[dy + reach] - half width in cells of disc's row @dy */
+	int reach;
+	std::vector<int> half_width;
+	/**
+	 * prefix sums of deposit by rows: row @y occupies (@cells + 1)
+	 * elements starting from y * (@cells + 1), element 0 is zero
+	 */
+	std::vector<double> prefix_vx;
+	std::vector<double> prefix_vy;
+	std::vector<double> prefix_n;
+	/* deposit convolved with the disc, node (x, y) is y * @cells + x */
+	std::vector<double> field_vx;
+	std::vector<double> field_vy;
+	std::vector<double> field_n;
+
+	/**
+	 * nodes - lower nodes @x0, @y0 of the 4 ones around @position
+	 * (node is at center of its cell), @tx, @ty - weights of upper ones
+	 */
+	inline void nodes(const Point &position, int &x0, int &y0,
+			double &tx, double &ty) const;
+	/* node offset (@dx, @dy) is in the disc kernel, periodic */
+	bool in_kernel(int dx, int dy) const;
+	/**
+	 * less weight of other particles is what remains of excluding
+	 * the particle's own one, by rounding: it's alone in the disc
+	 */
+	static constexpr double min_weight = 1e-9;
+	/* sums of deposit row @y over nodes [@from, @to], periodic */
+	void row_sum(int y, int from, int to,
+			double &vx, double &vy, double &n) const;
+};
+
+#endif /* __SSU_KMY_MESH_H_ */
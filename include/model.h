@@ -0,0 +1,143 @@
+#ifndef __SSU_KMY_MODEL_H_
+#define __SSU_KMY_MODEL_H_
+
+#include <cmath>
+#include <cassert>
+#include "point.h"
+
+/* four independent standard normal deviates driving one particle per step */
+struct Noise {
+	ld x;
+	ld y;
+	ld v;
+	ld phi;
+};
+
+/* integration schemes of the velocity, see Model::speed */
+enum scheme_id {
+	scheme_heun, scheme_split
+};
+
+/**
+ * Parameters of the velocity dynamics
+ *   dv = f(v, u_A) dt + g_E dW_E + g_v(v) dW_v + g_phi(v) dW_phi,
+ *   f(v, u_A) = e_v - v + mu * (u_A - v),
+ * and its Heun integration step.
+ * Arithmetic of @heun_speed follows the Point-based formulation
+ * operation by operation, so that both give identical results.
+ * If @error is given, it gets squared distance between the Heun
+ * result and its Euler predictor, an estimate of local error.
+ */
+struct Model {
+	ld mu;
+	ld h;
+	ld sqrt_h;
+	ld sqrt2_D_E;
+	ld sqrt2_D_v;
+	ld sqrt2_D_phi;
+	scheme_id scheme = scheme_heun;
+	/* constants of @split_speed, computed by @prepare */
+	ld relax_share;
+	ld half_decay;
+	ld ou_sigma;
+
+	/* should be called after change of @mu, @h or @sqrt2_D_E */
+	void prepare()
+	{
+		ld k = 1 + mu;
+		relax_share = mu / k;
+		half_decay = exp(-0.5 * k * h);
+		ou_sigma = sqrt2_D_E * sqrt((1 - exp(-2 * k * h)) / (2 * k));
+	}
+
+	/* velocity after one step by @scheme */
+	Point speed(const Point &v0, const Point &u_A, const Noise &xi,
+			ld *error = nullptr) const
+	{
+		if (scheme == scheme_split)
+			return split_speed(v0, u_A, xi);
+		return heun_speed(v0, u_A, xi, error);
+	}
+
+	Point heun_speed(const Point &v0, const Point &u_A,
+			const Noise &xi, ld *error = nullptr) const
+	{
+		ld len0 = sqrt(v0._x * v0._x + v0._y * v0._y);
+		assert(fabs(len0) > 1e-7);
+		ld ex0 = v0._x / len0, ey0 = v0._y / len0;
+		ld f0x = ex0 - v0._x + mu * (u_A._x - v0._x);
+		ld f0y = ey0 - v0._y + mu * (u_A._y - v0._y);
+		ld gE = sqrt2_D_E;
+		ld gv0x = sqrt2_D_v * ex0, gv0y = sqrt2_D_v * ey0;
+		ld gphi0x = sqrt2_D_phi * -ey0, gphi0y = sqrt2_D_phi * ex0;
+
+		ld v1x = v0._x + f0x * h + sqrt_h *
+			(gE * xi.x + gv0x * xi.v + gphi0x * xi.phi);
+		ld v1y = v0._y + f0y * h + sqrt_h *
+			(gE * xi.y + gv0y * xi.v + gphi0y * xi.phi);
+
+		ld len1 = sqrt(v1x * v1x + v1y * v1y);
+		assert(fabs(len1) > 1e-7);
+		ld ex1 = v1x / len1, ey1 = v1y / len1;
+		ld f1x = ex1 - v1x + mu * (u_A._x - v1x);
+		ld f1y = ey1 - v1y + mu * (u_A._y - v1y);
+		ld gv1x = sqrt2_D_v * ex1, gv1y = sqrt2_D_v * ey1;
+		ld gphi1x = sqrt2_D_phi * -ey1, gphi1y = sqrt2_D_phi * ex1;
+
+		ld gE_avg = (gE + gE) * 0.5;
+		ld v2x = v0._x + (f0x + f1x) * 0.5 * h +
+			(gE_avg * xi.x + (gv0x + gv1x) * 0.5 * xi.v +
+			 (gphi0x + gphi1x) * 0.5 * xi.phi) * sqrt_h;
+		ld v2y = v0._y + (f0y + f1y) * 0.5 * h +
+			(gE_avg * xi.y + (gv0y + gv1y) * 0.5 * xi.v +
+			 (gphi0y + gphi1y) * 0.5 * xi.phi) * sqrt_h;
+		if (error != nullptr)
+			*error = (v2x - v1x) * (v2x - v1x) + (v2y - v1y) * (v2y - v1y);
+		return Point(v2x, v2y);
+	}
+
+	/**
+	 * split_speed - operator splitting A(h/2) B(h) A(h/2), where
+	 *   A: dv = -(1 + mu) v dt + mu u_A dt + g_E dW_E
+	 * is Ornstein-Uhlenbeck process, solved exactly, and
+	 *   B: d|v| = dt + g_v dW_v,  d(arg v) = g_phi / |v| dW_phi
+	 * is the drive and the multiplicative noise in polar form
+	 * (one sqrt and one rotation instead of two unit vectors).
+	 * Noise of A for the whole step is added in the second half:
+	 * with B being identity it's the exact distribution, and
+	 * D_E is the weakest noise of the model.
+	 * Stable for h several times larger than Heun's one.
+	 */
+	Point split_speed(const Point &v0, const Point &u_A,
+			const Noise &xi) const
+	{
+		ld ux = relax_share * u_A._x, uy = relax_share * u_A._y;
+		ld vx = ux + (v0._x - ux) * half_decay;
+		ld vy = uy + (v0._y - uy) * half_decay;
+
+		ld rho0 = sqrt(vx * vx + vy * vy);
+		assert(rho0 > 1e-7);
+		ld ex = vx / rho0, ey = vy / rho0;
+		ld rho1 = rho0 + h + sqrt2_D_v * sqrt_h * xi.v;
+		if (rho1 < 0) {
+			rho1 = -rho1;
+			ex = -ex;
+			ey = -ey;
+		}
+		/* Stratonovich: angular step is taken at mean radius */
+		ld dphi = 2 * sqrt2_D_phi * sqrt_h * xi.phi / (rho0 + rho1);
+		ld c = cos(dphi), s = sin(dphi);
+		vx = rho1 * (ex * c - ey * s);
+		vy = rho1 * (ey * c + ex * s);
+
+		return Point(ux + (vx - ux) * half_decay + ou_sigma * xi.x,
+			uy + (vy - uy) * half_decay + ou_sigma * xi.y);
+	}
+
+	Point heun_position(const Point &r, const Point &v) const
+	{
+		return Point(r._x + v._x * h, r._y + v._y * h);
+	}
+};
+
+#endif /* __SSU_KMY_MODEL_H_ */
@@ -0,0 +1,92 @@
+#ifndef __SSU_KMY_NOISE_BUFFER_H_
+#define __SSU_KMY_NOISE_BUFFER_H_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include "model.h"
+#include "stream_gen.h"
+#include "thread_pool.h"
+
+/**
+ * Ring of noise for @steps future steps, filled in advance by
+ * a background producer thread from StreamGen. Noise of a step
+ * depends on the step only, so consuming it from the buffer gives
+ * the same trajectory as calling StreamGen::noise directly.
+ * There is one producer and one consumer, they are synchronized
+ * by two atomic step counters only (no locks while neither waits):
+ *   @produced - steps [0, @produced) are ready,
+ *   @consumed - steps [0, @consumed) may be overwritten;
+ * the side which has to wait for the other raises its flag and
+ * sleeps on @ready or @space, the other side takes @mutex and
+ * wakes it only if it sees the flag after moving its counter.
+ */
+class NoiseBuffer
+{
+public:
+	explicit NoiseBuffer(int steps);
+	~NoiseBuffer();
+	/**
+	 * acquire - waits for noise of step @step for @particles particles
+	 * from @gen and returns it indexed by stable particle id;
+	 * the producer is restarted if it works on anything else
+	 * (other seed, number of particles or sequence of steps).
+	 * Waiting for not yet produced step is counted as an underrun.
+	 */
+	const Noise *acquire(const StreamGen &gen, int particles, uint64_t step);
+	/* noise of the last acquired step is not needed any more */
+	void release();
+	/**
+	 * set_placement - ring is first touched by threads of @pool
+	 * (see first_touch) at every restart of producer, by the same
+	 * partition of particles in each step; NULL turns it off
+	 */
+	void set_placement(ThreadPool *pool, bool huge_pages);
+	/**
+	 * get_producer_affinity - CPUs the producer may run on: when
+	 * the placement pool is pinned, those it leaves spare (see
+	 * ThreadPool::spare_cpus), so that noise is made alongside
+	 * the workers; @returns false if there is no producer
+	 */
+	bool get_producer_affinity(cpu_set_t &mask);
+	/* counters since the last restart of producer */
+	long long get_underruns() const { return underruns; }
+	long long get_acquired() const { return acquired; }
+private:
+	int steps;
+	int particles;
+	StreamGen gen;
+	uint64_t first_step;
+	std::vector<Noise> ring;
+	ThreadPool *placement;
+	bool huge_pages;
+	std::thread producer;
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> produced;
+	std::atomic<uint64_t> consumed;
+	std::mutex mutex;
+	/* @produced has grown, the consumer waits if @consumer_waits */
+	std::condition_variable ready;
+	std::atomic<bool> consumer_waits;
+	/* @consumed has grown or @stopping is set */
+	std::condition_variable space;
+	std::atomic<bool> producer_waits;
+	long long underruns;
+	long long acquired;
+
+	void start(const StreamGen &gen, int particles, uint64_t step);
+	void stop();
+	void produce();
+	Noise *slot(uint64_t step)
+	{
+		return &ring[(step % steps) * particles];
+	}
+
+	NoiseBuffer(const NoiseBuffer &);
+	NoiseBuffer &operator=(const NoiseBuffer &);
+};
+
+#endif /* __SSU_KMY_NOISE_BUFFER_H_ */
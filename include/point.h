@@ -9,6 +9,11 @@ class Point
 {
 	friend class Grid;
 	friend class Cluster;
+	friend struct Model;
+	friend class PointSum;
+	friend class Mesh;
+	friend class Domain;
+	friend class FixedFrame;
 public:
 	Point() {}
 	Point(ld x, ld y) : _x(x), _y(y) {}
@@ -0,0 +1,130 @@
+#ifndef __SSU_KMY_PROFILER_H_
+#define __SSU_KMY_PROFILER_H_
+
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "types.h"
+
+/**
+ * Hot-path instrumentation: per-phase timers and event counters.
+ * Everything is compiled in only with -DPROFILE (make PROFILE=1),
+ * otherwise PROFILE_* macros expand to nothing.
+ * Timers are summed over threads, i.e. they measure CPU time;
+ * phases may nest (noise is drawn inside integration).
+ */
+
+enum profile_phase {
+	ph_noise, ph_grid_update, ph_neighbours, ph_integration,
+	ph_measurement, NUMBER_OF_PHASES
+};
+
+enum profile_counter {
+	cnt_steps, cnt_particle_steps, cnt_queries, cnt_neighbours,
+	cnt_cells_visited, cnt_boundary_cells, cnt_cell_changes,
+	NUMBER_OF_COUNTERS
+};
+
+class Profiler
+{
+public:
+	static Profiler& Instance();
+	/* time stamp in ticks: TSC where available, nanoseconds otherwise */
+	static uint64_t now()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+	void add_ticks(profile_phase phase, uint64_t ticks)
+	{
+		phase_ticks[phase].fetch_add(ticks, std::memory_order_relaxed);
+		phase_calls[phase].fetch_add(1, std::memory_order_relaxed);
+	}
+	void count(profile_counter counter, long long n)
+	{
+		counters[counter].fetch_add(n, std::memory_order_relaxed);
+	}
+	/* NUMA nodes, modelled memory traffic of which is told apart */
+	static const int max_nodes = 8;
+	/**
+	 * count_bytes - @bytes of modelled memory traffic by threads
+	 * of @node: sizes of arrays the code streams, not a measurement
+	 * (caches and hardware prefetch aren't seen)
+	 */
+	void count_bytes(int node, long long bytes)
+	{
+		node_bytes[node < max_nodes ? node : max_nodes - 1].fetch_add(
+			bytes, std::memory_order_relaxed);
+	}
+	/* stated peak bandwidth of one node, GB/s, 0 if unknown */
+	void set_peak_bandwidth(double gb_per_s) { peak_bandwidth = gb_per_s; }
+	void reset();
+	void print_summary(FILE *out) const;
+	/* one JSON object per line */
+	void dump_json(FILE *out, ld D_phi) const;
+private:
+	Profiler();
+	Profiler(const Profiler &);
+	Profiler &operator=(const Profiler &);
+
+	std::atomic<unsigned long long> phase_ticks[NUMBER_OF_PHASES];
+	std::atomic<unsigned long long> phase_calls[NUMBER_OF_PHASES];
+	std::atomic<long long> counters[NUMBER_OF_COUNTERS];
+	std::atomic<long long> node_bytes[max_nodes];
+	double peak_bandwidth;
+	uint64_t start_ticks;
+	std::chrono::steady_clock::time_point start_time;
+
+	/* ticks per second, calibrated over time since reset */
+	double tick_rate() const;
+	double wall_seconds() const;
+};
+
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(profile_phase phase) :
+		phase(phase), start(Profiler::now()) {}
+	~ScopedTimer()
+	{
+		Profiler::Instance().add_ticks(phase, Profiler::now() - start);
+	}
+private:
+	profile_phase phase;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILE
+#define PROFILE_SCOPE(phase) \
+	ScopedTimer PROFILE_CONCAT(profile_timer_, __LINE__)(phase)
+#define PROFILE_COUNT(counter, n) \
+	Profiler::Instance().count(counter, n)
+#define PROFILE_BYTES(node, n) \
+	Profiler::Instance().count_bytes(node, n)
+/* accumulation into a local variable, for timing inside tight loops */
+#define PROFILE_LOCAL(name) uint64_t name = 0
+#define PROFILE_START(name) uint64_t PROFILE_CONCAT(name, _start) = Profiler::now()
+#define PROFILE_STOP(name) name += Profiler::now() - PROFILE_CONCAT(name, _start)
+#define PROFILE_FLUSH(phase, name) Profiler::Instance().add_ticks(phase, name)
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_BYTES(node, n)
+#define PROFILE_LOCAL(name)
+#define PROFILE_START(name)
+#define PROFILE_STOP(name)
+#define PROFILE_FLUSH(phase, name)
+#endif
+
+#endif /* __SSU_KMY_PROFILER_H_ */
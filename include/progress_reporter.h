@@ -0,0 +1,61 @@
+#ifndef __SSU_KMY_PROGRESS_REPORTER_H
+#define __SSU_KMY_PROGRESS_REPORTER_H
+
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "types.h"
+
+/**
+ * Machine-readable alternative to ProgressBar: a separate thread
+ * wakes up every @interval seconds and prints one line like
+ *   progress phase=relaxation D_phi=0.024546 step=1200/100000
+ *     elapsed=12.0 rate=1.02e+06 eta=986.3 order=0.5310
+ * where @rate is in particle-steps per second and @eta in seconds.
+ * The stepping thread only stores its position into an atomic counter;
+ * the order parameter is sampled by it on request (@wants_order),
+ * at most once per interval.
+ */
+class ProgressReporter {
+public:
+	ProgressReporter(FILE *out, double interval);
+	~ProgressReporter();
+	void start(const char *phase, ld D_phi, int steps, int particles);
+	void finish();
+	void advance(int done_steps_arg)
+	{
+		done_steps.store(done_steps_arg, std::memory_order_relaxed);
+	}
+	bool wants_order() const
+	{
+		return order_requested.load(std::memory_order_relaxed);
+	}
+	void set_order(ld value);
+private:
+	FILE *out;
+	std::chrono::duration<double> interval;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+	bool active;
+
+	char phase[32];
+	ld D_phi;
+	int steps;
+	int particles;
+	std::chrono::steady_clock::time_point started;
+	std::atomic<int> done_steps;
+	std::atomic<bool> order_requested;
+	ld order;
+	bool order_known;
+
+	void loop();
+	/* should be called with @mutex held */
+	void report();
+};
+
+#endif /* __SSU_KMY_PROGRESS_REPORTER_H */
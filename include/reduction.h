@@ -0,0 +1,84 @@
+#ifndef __SSU_KMY_REDUCTION_H_
+#define __SSU_KMY_REDUCTION_H_
+
+#include <vector>
+#include <algorithm>
+#include "point.h"
+#include "thread_pool.h"
+
+/* number of terms in one block of blocked_sum, independent of threads */
+const int reduction_block = 4096;
+
+/**
+ * KahanSum - compensated (Neumaier) accumulator,
+ * error of the sum doesn't grow with number of terms
+ */
+class KahanSum
+{
+public:
+	KahanSum() : sum(0), c(0) {}
+	void add(ld x)
+	{
+		ld t = sum + x;
+		if (fabs(sum) >= fabs(x))
+			c += (sum - t) + x;
+		else
+			c += (x - t) + sum;
+		sum = t;
+	}
+	void add(const KahanSum &other)
+	{
+		add(other.sum);
+		add(other.c);
+	}
+	ld value() const { return sum + c; }
+private:
+	ld sum;
+	ld c;
+};
+
+class PointSum
+{
+public:
+	void add(const Point &p)
+	{
+		x.add(p._x);
+		y.add(p._y);
+	}
+	void add(const PointSum &other)
+	{
+		x.add(other.x);
+		y.add(other.y);
+	}
+	Point value() const { return Point(x.value(), y.value()); }
+private:
+	KahanSum x;
+	KahanSum y;
+};
+
+/**
+ * blocked_sum - sum of @term(i) for i in [0, @n)
+ * Terms are summed by fixed blocks of @reduction_block terms
+ * (in parallel on @pool) and then block sums are added in order
+ * of blocks, so the result is bitwise the same for any pool size.
+ * @partial is scratch storage, kept by caller to avoid allocations
+ */
+template<typename Sum, typename Term>
+Sum blocked_sum(ThreadPool &pool, int n, std::vector<Sum> &partial,
+		const Term &term)
+{
+	const int blocks = (n + reduction_block - 1) / reduction_block;
+	partial.assign(blocks, Sum());
+	pool.run(blocks, [&] (int block, int) {
+		int end = std::min(n, (block + 1) * reduction_block);
+		Sum &sum = partial[block];
+		for (int i = block * reduction_block; i < end; ++i)
+			sum.add(term(i));
+	});
+	Sum total;
+	for (int i = 0; i < blocks; ++i)
+		total.add(partial[i]);
+	return total;
+}
+
+#endif /* __SSU_KMY_REDUCTION_H_ */
@@ -0,0 +1,51 @@
+#ifndef __SSU_KMY_RESULT_CACHE_H_
+#define __SSU_KMY_RESULT_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "types.h"
+
+/**
+ * Description of a simulation: name=value pairs of everything
+ * its result depends on, in order of adding
+ */
+class CacheKey
+{
+public:
+	void add(const char *name, ld value);
+	void add(const char *name, const char *value);
+	const std::string &text() const { return key; }
+	/* FNV-1a of @text */
+	uint64_t hash() const;
+private:
+	std::string key;
+};
+
+/**
+ * Measured values stored on disk by key: file @directory/<hash>
+ * keeps the full key (with @version, so that changing it drops
+ * everything stored before) in the first line and the values
+ * in the second; a file of other key with the same hash is a miss
+ */
+class ResultCache
+{
+public:
+	ResultCache(const char *directory, const char *version);
+	/* @returns true and fills @values if @key is stored with any */
+	bool lookup(const CacheKey &key, std::vector<ld> &values);
+	/* @returns false if file can't be written */
+	bool store(const CacheKey &key, const std::vector<ld> &values);
+	int get_hits() const { return hits; }
+	int get_misses() const { return misses; }
+private:
+	std::string directory;
+	std::string version;
+	int hits;
+	int misses;
+
+	CacheKey versioned(const CacheKey &key) const;
+	std::string file_name(const CacheKey &key) const;
+};
+
+#endif /* __SSU_KMY_RESULT_CACHE_H_ */
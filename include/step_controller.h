@@ -0,0 +1,39 @@
+#ifndef __SSU_KMY_STEP_CONTROLLER_H_
+#define __SSU_KMY_STEP_CONTROLLER_H_
+
+#include <cstdio>
+#include "types.h"
+
+/**
+ * Adaptive step size for the Heun scheme: error estimate of a step
+ * (distance between Heun result and its Euler predictor, see Model)
+ * chooses size of the next one, keeping it within [@h_min, @h_max].
+ * Steps are never rejected: a rejected step would have to be redone
+ * with noise conditioned on the rejection (Brownian bridge), while
+ * choosing the size from the past only keeps noise of every step
+ * independent of its size.
+ */
+class StepController
+{
+public:
+	StepController(ld tolerance, ld h_min, ld h_max);
+	/* starts new series of steps from @h, resets statistics */
+	void start(ld h);
+	ld get_h() const { return h; }
+	/* step of size @h_used was made with local error @error */
+	void update(ld h_used, ld error);
+	/* prints number of steps and sizes of them to @out */
+	void report(FILE *out, const char *phase) const;
+private:
+	ld tolerance;
+	ld h_min;
+	ld h_max;
+	ld h;
+
+	int steps;
+	ld time;
+	ld smallest;
+	ld largest;
+};
+
+#endif /* __SSU_KMY_STEP_CONTROLLER_H_ */
@@ -0,0 +1,76 @@
+#ifndef __SSU_KMY_STREAM_GEN_H_
+#define __SSU_KMY_STREAM_GEN_H_
+
+#include <cmath>
+#include <stdint.h>
+#include "model.h"
+
+/**
+ * Counter-based source of gaussian noise: deviates for particle @id
+ * at step @step are a pure function of (seed, step, id), so particles
+ * can be integrated in any order and by any number of threads
+ * with the same outcome (unlike GaussianGen, which is sequential).
+ */
+class StreamGen
+{
+public:
+	StreamGen(uint64_t seed = 0) : seed(seed) {}
+	void set_seed(uint64_t nseed) { seed = nseed; }
+	uint64_t get_seed() const { return seed; }
+
+	/* key of step @step, to be passed to @noise for each particle */
+	uint64_t step_key(uint64_t step) const
+	{
+		return mix(seed + mix(step));
+	}
+
+	void noise(uint64_t key, uint32_t id, Noise *xi) const
+	{
+		ld u[4];
+		uniforms(key, id, u);
+		gaussians(u, xi);
+	}
+
+	/* four uniform deviates in (0, 1] for particle @id */
+	void uniforms(uint64_t key, uint32_t id, ld u[4]) const
+	{
+		uint64_t base = key + ((uint64_t) id << 2);
+		for (int k = 0; k < 4; ++k)
+			u[k] = to_unit(mix(base + k));
+	}
+
+	/**
+	 * splitmix64 finalizer; deviates of particle @id are made
+	 * of counters key + 4 * id + k, k < 4 (see Kernels::noise)
+	 */
+	static uint64_t mix(uint64_t z)
+	{
+		z += 0x9e3779b97f4a7c15ULL;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	/* maps to (0, 1], so that log() is always finite */
+	static ld to_unit(uint64_t z)
+	{
+		return ((z >> 11) + 1) * (1.0 / 9007199254740992.0);
+	}
+
+	/* Box-Muller transform of four uniform deviates */
+	static void gaussians(const ld u[4], Noise *xi)
+	{
+		ld r1 = sqrt(-2 * log(u[0]));
+		ld r2 = sqrt(-2 * log(u[2]));
+		xi->x = r1 * cos(two_pi * u[1]);
+		xi->y = r1 * sin(two_pi * u[1]);
+		xi->v = r2 * cos(two_pi * u[3]);
+		xi->phi = r2 * sin(two_pi * u[3]);
+	}
+
+private:
+	uint64_t seed;
+	static constexpr ld two_pi = 6.283185307179586476925286766559;
+};
+
+#endif /* __SSU_KMY_STREAM_GEN_H_ */
@@ -0,0 +1,52 @@
+#ifndef __SSU_KMY_SWEEP_H_
+#define __SSU_KMY_SWEEP_H_
+
+#include <vector>
+#include <string>
+#include <utility>
+#include "types.h"
+
+/* one point of parameter space, one simulation job */
+struct SweepPoint {
+	int N;
+	ld epsilon;
+	ld mu;
+	ld D_E;
+	ld D_phi;
+	/* position in order of definition, keys the noise of the job */
+	int index;
+	/* estimated amount of work, see Sweep::plan */
+	ld cost;
+};
+
+/**
+ * Set of parameter points to be simulated: either Cartesian product
+ * of axes, or a list of points given explicitly; parameters not swept
+ * keep values of @base. Names of parameters are the config ones:
+ * number_of_particles, epsilon, mu, passive_noise, angular_noise.
+ */
+class Sweep
+{
+public:
+	explicit Sweep(const SweepPoint &base) : base(base) {}
+	/* @returns false if @name is unknown */
+	bool add_axis(const char *name, const std::vector<ld> &values);
+	bool has_axis(const char *name) const;
+	bool add_point(const std::vector<std::pair<std::string, ld> > &values);
+	/**
+	 * plan - all points ordered by estimated cost, largest first
+	 * (so that jobs taken in this order by a pool of workers give
+	 * short makespan); cost is number of particle-steps times
+	 * 1 + expected number of neighbours in disc of @epsilon
+	 */
+	std::vector<SweepPoint> plan(ld L, bool local_visibility,
+		int steps) const;
+private:
+	SweepPoint base;
+	std::vector<std::pair<std::string, std::vector<ld> > > axes;
+	std::vector<SweepPoint> points;
+
+	static bool set(SweepPoint &point, const std::string &name, ld value);
+};
+
+#endif /* __SSU_KMY_SWEEP_H_ */
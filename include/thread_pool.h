@@ -0,0 +1,75 @@
+#ifndef __SSU_KMY_THREAD_POOL_H_
+#define __SSU_KMY_THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Fixed set of worker threads executing indexed tasks.
+ * The calling thread takes part in the work as thread #0,
+ * so a pool of size 1 runs everything inline.
+ */
+class ThreadPool
+{
+public:
+	typedef std::function<void (int task, int thread)> job_t;
+
+	explicit ThreadPool(int threads = 1);
+	~ThreadPool();
+	int size() const;
+	/**
+	 * runs @job for every task in [0, @tasks) and returns
+	 * when all of them are done; tasks are handed out
+	 * dynamically, so @job must not rely on their order
+	 */
+	void run(int tasks, const job_t &job);
+	/**
+	 * pin - thread #t is bound to CPU @cpus[t] (the calling thread
+	 * too, until the pool is destroyed); from then on tasks are dealt
+	 * statically: thread #t runs the t-th of equal contiguous parts
+	 * of them, so the data a task range works on stays with one
+	 * thread (and NUMA node) from run to run; @returns false and
+	 * leaves the pool as it was if any thread can't be bound
+	 */
+	bool pin(const std::vector<int> &cpus);
+	bool is_pinned() const { return pinned; }
+	/**
+	 * spare_cpus - CPUs the calling thread could run on before @pin
+	 * and none of the pool's threads is bound to, or all of those
+	 * CPUs if the pool takes every one; for helper threads started
+	 * by a pinned thread, which would share its CPU otherwise;
+	 * @returns false if the pool isn't pinned
+	 */
+	bool spare_cpus(cpu_set_t &mask) const;
+private:
+	int threads;
+	bool pinned;
+	/* the thread that pinned the pool and its affinity before */
+	pthread_t caller;
+	cpu_set_t caller_mask;
+	std::vector<int> pinned_cpus;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const job_t *job;
+	int tasks;
+	std::atomic<int> next_task;
+	int busy;
+	unsigned long generation;
+	bool stopping;
+
+	void worker_loop(int thread);
+	void drain(int thread);
+
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif /* __SSU_KMY_THREAD_POOL_H_ */
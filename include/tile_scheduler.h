@@ -0,0 +1,42 @@
+#ifndef __SSU_KMY_TILE_SCHEDULER_H_
+#define __SSU_KMY_TILE_SCHEDULER_H_
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+/**
+ * Distribution of spatial tiles among worker threads:
+ * @plan deals tiles out largest-cost-first, each to the worker
+ * with the least cost so far; during the step a worker takes tiles
+ * from the front of its own queue and, once it's empty, steals
+ * from the back of the others' queues.
+ */
+class TileScheduler
+{
+public:
+	TileScheduler();
+	~TileScheduler();
+	void plan(const std::vector<double> &costs, int workers);
+	/* @returns next tile for @worker or -1, if all tiles are taken */
+	int next(int worker);
+	/* number of tiles stolen since the last @plan */
+	int get_steals() const;
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::vector<int> tiles;
+		int front;
+		int back;
+	};
+	Queue *queues;
+	int workers;
+	std::atomic<int> steals;
+	std::vector<int> order;
+	std::vector<double> load;
+
+	TileScheduler(const TileScheduler &);
+	TileScheduler &operator=(const TileScheduler &);
+};
+
+#endif /* __SSU_KMY_TILE_SCHEDULER_H_ */
@@ -0,0 +1,77 @@
+#ifndef __SSU_KMY_TOPOLOGY_H_
+#define __SSU_KMY_TOPOLOGY_H_
+
+#include <cstddef>
+#include <vector>
+#include "thread_pool.h"
+
+/**
+ * NUMA nodes (sockets, as a rule) and their CPUs, as sysfs tells,
+ * restricted to CPUs the process may run on (its cpuset); nodes
+ * are numbered among those having such CPUs; without NUMA
+ * information all CPUs are on node 0
+ */
+class Topology
+{
+public:
+	static const Topology &Instance();
+	int cpus() const { return usable_cpus; }
+	int nodes() const { return (int) node_cpus.size(); }
+	/* node of @cpu, 0 if unknown */
+	int node(int cpu) const;
+	/* node of the CPU the calling thread runs on */
+	int current_node() const;
+	/**
+	 * placement - CPUs for @threads threads by @policy:
+	 * "compact" fills nodes one after another, "scatter" deals
+	 * threads to nodes in turn; CPUs are reused if there are
+	 * fewer of them; @returns false if @policy is unknown
+	 */
+	bool placement(const char *policy, int threads,
+		std::vector<int> &cpus) const;
+private:
+	std::vector<int> node_of;
+	std::vector<std::vector<int> > node_cpus;
+	int usable_cpus;
+
+	Topology();
+	Topology(const Topology &);
+	Topology &operator=(const Topology &);
+};
+
+/**
+ * release_pages - physical pages lying completely in [@data,
+ * @data + @bytes) are given back, they'll be allocated on the node
+ * of the thread touching them first; marked for transparent huge
+ * pages before that if @huge_pages
+ */
+void release_pages(void *data, size_t bytes, bool huge_pages);
+
+/**
+ * first_touch - @count elements at @data become @value, each of
+ * @pool's threads writes its static part (see ThreadPool::pin)
+ * into released pages, so they're allocated on its node
+ */
+template<typename T>
+void first_touch(T *data, size_t count, ThreadPool &pool, bool huge_pages,
+	const T &value = T())
+{
+	release_pages(data, count * sizeof(T), huge_pages);
+	const int parts = pool.size();
+	pool.run(parts, [&] (int part, int) {
+		size_t end = count * (part + 1) / parts;
+		for (size_t i = count * part / parts; i < end; ++i)
+			data[i] = value;
+	});
+}
+
+/* the same for @count elements of vector @v, resized to it */
+template<typename T>
+void first_touch(std::vector<T> &v, size_t count, ThreadPool &pool,
+	bool huge_pages, const T &value = T())
+{
+	v.resize(count);
+	first_touch(v.data(), count, pool, huge_pages, value);
+}
+
+#endif /* __SSU_KMY_TOPOLOGY_H_ */
@@ -0,0 +1,44 @@
+#ifndef __SSU_KMY_TRANSITION_SEARCH_H_
+#define __SSU_KMY_TRANSITION_SEARCH_H_
+
+#include <cstdio>
+#include <vector>
+#include <utility>
+#include "types.h"
+
+/**
+ * Order of D_phi points to measure: the coarse ones first, then
+ * the interval between neighbouring measured points where the
+ * order parameter changes most is bisected again and again, until
+ * it's not wider than @resolution or @max_points are measured.
+ * So points gather around the transition instead of the flat
+ * ordered and disordered regions. @resolution <= 0 leaves only
+ * the coarse points.
+ */
+class TransitionSearch
+{
+public:
+	/* @geometric: bisect by geometric mean (for logarithmic grid) */
+	TransitionSearch(const std::vector<ld> &coarse, bool geometric,
+			ld resolution, int max_points);
+	/* @returns false if nothing is left to measure */
+	bool next(ld &D_phi);
+	/* order parameter measured at @D_phi given by @next */
+	void record(ld D_phi, ld order);
+	int get_measured() const { return (int) measured.size(); }
+	/* prints the steepest interval found */
+	void report(FILE *out) const;
+private:
+	std::vector<ld> coarse;
+	size_t coarse_next;
+	bool geometric;
+	ld resolution;
+	int max_points;
+	/* (D_phi, order parameter), sorted by D_phi */
+	std::vector<std::pair<ld, ld> > measured;
+
+	/* @returns -1 if less than two points are measured */
+	int steepest() const;
+};
+
+#endif /* __SSU_KMY_TRANSITION_SEARCH_H_ */
@@ -0,0 +1,149 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "kernels.h"
+#include "stream_gen.h"
+
+/**
+ * Bodies are inlined into one function per instruction set, so the
+ * vectoriser compiles each of them for its vector width. Contraction
+ * to FMA is off (see Makefile), it would change results by variant.
+ */
+#define KERNEL_BODY inline __attribute__((always_inline))
+
+/* ids are taken by chunks, counters of a chunk are consecutive */
+static const int noise_chunk = 64;
+
+static KERNEL_BODY void noise_body(uint64_t key, uint32_t first, int count,
+	Noise *xi)
+{
+	uint64_t z[4 * noise_chunk];
+	ld u[4 * noise_chunk];
+	for (int start = 0; start < count; start += noise_chunk) {
+		const int n = 4 * std::min(noise_chunk, count - start);
+		const uint64_t base = key + ((uint64_t) (first + start) << 2);
+		for (int j = 0; j < n; ++j)
+			z[j] = StreamGen::mix(base + j);
+		for (int j = 0; j < n; ++j)
+			u[j] = StreamGen::to_unit(z[j]);
+		for (int j = 0; j < n; j += 4)
+			StreamGen::gaussians(u + j, xi + start + j / 4);
+	}
+}
+
+static KERNEL_BODY void cell_indices_body(const Point *positions,
+	int count, double cell_xsize, double cell_ysize, int xcells,
+	int ycells, int *cells)
+{
+	static_assert(sizeof(Point) == 2 * sizeof(double),
+		"Point is a pair of coordinates");
+	const double *xy = reinterpret_cast<const double *>(positions);
+	for (int i = 0; i < count; ++i) {
+		int cell_x = (int) (xy[2 * i] / cell_xsize);
+		int cell_y = (int) (xy[2 * i + 1] / cell_ysize);
+		cell_x = cell_x < 0 ? 0 : (cell_x >= xcells ? xcells - 1 : cell_x);
+		cell_y = cell_y < 0 ? 0 : (cell_y >= ycells ? ycells - 1 : cell_y);
+		cells[i] = cell_x * ycells + cell_y;
+	}
+}
+
+typedef void (*noise_kernel)(uint64_t, uint32_t, int, Noise *);
+typedef void (*cell_indices_kernel)(const Point *, int, double, double,
+	int, int, int *);
+
+#define DEFINE_KERNELS(suffix, target) \
+	target static void noise_##suffix(uint64_t key, uint32_t first, \
+		int count, Noise *xi) \
+	{ \
+		noise_body(key, first, count, xi); \
+	} \
+	target static void cell_indices_##suffix(const Point *positions, \
+		int count, double cell_xsize, double cell_ysize, int xcells, \
+		int ycells, int *cells) \
+	{ \
+		cell_indices_body(positions, count, cell_xsize, cell_ysize, \
+			xcells, ycells, cells); \
+	}
+
+DEFINE_KERNELS(sse2, )
+#if defined(__x86_64__) || defined(__i386__)
+DEFINE_KERNELS(avx2, __attribute__((target("avx2"))))
+DEFINE_KERNELS(avx512, __attribute__((target("avx512f,avx512dq,avx512vl"))))
+#else
+#define noise_avx2 noise_sse2
+#define cell_indices_avx2 cell_indices_sse2
+#define noise_avx512 noise_sse2
+#define cell_indices_avx512 cell_indices_sse2
+#endif
+
+static const noise_kernel noise_kernels[isa_count] = {
+	noise_sse2, noise_avx2, noise_avx512
+};
+static const cell_indices_kernel cell_indices_kernels[isa_count] = {
+	cell_indices_sse2, cell_indices_avx2, cell_indices_avx512
+};
+static const char *isa_names[isa_count] = { "sse2", "avx2", "avx512" };
+
+isa_id Kernels::isa = Kernels::detect();
+
+bool Kernels::supported(isa_id isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	switch (isa) {
+	case isa_avx2:
+		return __builtin_cpu_supports("avx2");
+	case isa_avx512:
+		return __builtin_cpu_supports("avx512f") &&
+			__builtin_cpu_supports("avx512dq") &&
+			__builtin_cpu_supports("avx512vl");
+	default:
+		return true;
+	}
+#else
+	return isa == isa_sse2;
+#endif
+}
+
+isa_id Kernels::detect()
+{
+	for (int i = isa_count - 1; i > 0; --i)
+		if (supported((isa_id) i))
+			return (isa_id) i;
+	return isa_sse2;
+}
+
+void Kernels::select(isa_id isa_arg)
+{
+	assert(supported(isa_arg));
+	isa = isa_arg;
+}
+
+const char *Kernels::name(isa_id isa)
+{
+	return isa_names[isa];
+}
+
+bool Kernels::parse(const char *name, isa_id &isa)
+{
+	for (int i = 0; i < isa_count; ++i) {
+		if (strcmp(name, isa_names[i]) == 0) {
+			isa = (isa_id) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Kernels::noise(uint64_t key, uint32_t first, int count, Noise *xi)
+{
+	noise_kernels[isa](key, first, count, xi);
+}
+
+void Kernels::cell_indices(const Point *positions, int count,
+	double cell_xsize, double cell_ysize, int xcells, int ycells,
+	int *cells)
+{
+	cell_indices_kernels[isa](positions, count, cell_xsize, cell_ysize,
+		xcells, ycells, cells);
+}
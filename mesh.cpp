@@ -0,0 +1,155 @@
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "mesh.h"
+
+Mesh::Mesh(double size, int cells, double radius) :
+	size(size), cells(cells)
+{
+	assert(cells > 0);
+	cell_size = size / cells;
+	reach = (int) (radius / cell_size);
+	if (2 * reach + 1 > cells)
+		reach = (cells - 1) / 2;
+	double r2 = radius * radius;
+	for (int dy = -reach; dy <= reach; ++dy) {
+		int w = 0;
+		while (w + 1 <= reach &&
+			((w + 1) * (w + 1) + dy * dy) * cell_size * cell_size < r2)
+			++w;
+		half_width.push_back(w);
+	}
+	prefix_vx.resize(cells * (cells + 1));
+	prefix_vy.resize(cells * (cells + 1));
+	prefix_n.resize(cells * (cells + 1));
+	field_vx.resize(cells * cells);
+	field_vy.resize(cells * cells);
+	field_n.resize(cells * cells);
+}
+
+bool Mesh::in_kernel(int dx, int dy) const
+{
+	/* the nearest periodic image of the offset */
+	dx = ((dx % cells) + cells) % cells;
+	dy = ((dy % cells) + cells) % cells;
+	dx = std::min(dx, cells - dx);
+	dy = std::min(dy, cells - dy);
+	return dy <= reach && dx <= half_width[dy + reach];
+}
+
+inline void Mesh::nodes(const Point &position, int &x0, int &y0,
+		double &tx, double &ty) const
+{
+	double fx = position._x / cell_size - 0.5;
+	double fy = position._y / cell_size - 0.5;
+	x0 = (int) floor(fx);
+	y0 = (int) floor(fy);
+	tx = fx - x0;
+	ty = fy - y0;
+	/* positions are in [0, size), so nodes are in [-1, cells - 1] */
+	x0 = x0 < 0 ? x0 + cells : (x0 >= cells ? x0 - cells : x0);
+	y0 = y0 < 0 ? y0 + cells : (y0 >= cells ? y0 - cells : y0);
+}
+
+void Mesh::deposit(const std::vector<Point> &positions,
+		const std::vector<Point> &velocities)
+{
+	std::fill(prefix_vx.begin(), prefix_vx.end(), 0);
+	std::fill(prefix_vy.begin(), prefix_vy.end(), 0);
+	std::fill(prefix_n.begin(), prefix_n.end(), 0);
+	const int stride = cells + 1;
+	for (size_t i = 0; i < positions.size(); ++i) {
+		int x0, y0;
+		double tx, ty;
+		nodes(positions[i], x0, y0, tx, ty);
+		int x1 = x0 + 1 == cells ? 0 : x0 + 1;
+		int y1 = y0 + 1 == cells ? 0 : y0 + 1;
+		const int at[4] = { y0 * stride + x0 + 1, y0 * stride + x1 + 1,
+			y1 * stride + x0 + 1, y1 * stride + x1 + 1 };
+		const double weight[4] = { (1 - tx) * (1 - ty), tx * (1 - ty),
+			(1 - tx) * ty, tx * ty };
+		for (int k = 0; k < 4; ++k) {
+			prefix_vx[at[k]] += weight[k] * velocities[i]._x;
+			prefix_vy[at[k]] += weight[k] * velocities[i]._y;
+			prefix_n[at[k]] += weight[k];
+		}
+	}
+	for (int y = 0; y < cells; ++y) {
+		int row = y * stride;
+		for (int x = 1; x <= cells; ++x) {
+			prefix_vx[row + x] += prefix_vx[row + x - 1];
+			prefix_vy[row + x] += prefix_vy[row + x - 1];
+			prefix_n[row + x] += prefix_n[row + x - 1];
+		}
+	}
+	/* convolution with the disc, once for all particles */
+	for (int y = 0; y < cells; ++y)
+		for (int x = 0; x < cells; ++x) {
+			double vx = 0, vy = 0, n = 0;
+			for (int dy = -reach; dy <= reach; ++dy) {
+				int row = y + dy;
+				if (row < 0)
+					row += cells;
+				else if (row >= cells)
+					row -= cells;
+				int w = half_width[dy + reach];
+				row_sum(row, x - w, x + w, vx, vy, n);
+			}
+			field_vx[y * cells + x] = vx;
+			field_vy[y * cells + x] = vy;
+			field_n[y * cells + x] = n;
+		}
+}
+
+void Mesh::row_sum(int y, int from, int to,
+		double &vx, double &vy, double &n) const
+{
+	const int row = y * (cells + 1);
+	if (from < 0) {
+		row_sum(y, from + cells, cells - 1, vx, vy, n);
+		from = 0;
+	}
+	if (to >= cells) {
+		row_sum(y, 0, to - cells, vx, vy, n);
+		to = cells - 1;
+	}
+	vx += prefix_vx[row + to + 1] - prefix_vx[row + from];
+	vy += prefix_vy[row + to + 1] - prefix_vy[row + from];
+	n += prefix_n[row + to + 1] - prefix_n[row + from];
+}
+
+Point Mesh::get_disc_speed(const Point &position, const Point &velocity) const
+{
+	int x0, y0;
+	double tx, ty;
+	nodes(position, x0, y0, tx, ty);
+	int x1 = x0 + 1 == cells ? 0 : x0 + 1;
+	int y1 = y0 + 1 == cells ? 0 : y0 + 1;
+	const int at[4] = { y0 * cells + x0, y0 * cells + x1,
+		y1 * cells + x0, y1 * cells + x1 };
+	const double weight[4] = { (1 - tx) * (1 - ty), tx * (1 - ty),
+		(1 - tx) * ty, tx * ty };
+	double vx = 0, vy = 0, n = 0;
+	for (int k = 0; k < 4; ++k) {
+		vx += weight[k] * field_vx[at[k]];
+		vy += weight[k] * field_vy[at[k]];
+		n += weight[k] * field_n[at[k]];
+	}
+	/**
+	 * the particle's own deposit, as interpolation sees it: weight
+	 * of node j deposited to node k is taken if k is in the kernel
+	 * around j, it's less than 1 when the kernel is about a cell
+	 */
+	const int node_x[4] = { x0, x1, x0, x1 };
+	const int node_y[4] = { y0, y0, y1, y1 };
+	double self = 0;
+	for (int j = 0; j < 4; ++j)
+		for (int k = 0; k < 4; ++k)
+			if (in_kernel(node_x[k] - node_x[j], node_y[k] - node_y[j]))
+				self += weight[j] * weight[k];
+	n -= self;
+	if (n <= min_weight)
+		return Point(0, 0);
+	return Point((vx - self * velocity._x) / n,
+		(vy - self * velocity._y) / n);
+}
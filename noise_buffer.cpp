@@ -0,0 +1,126 @@
+#include <cassert>
+#include "noise_buffer.h"
+#include "kernels.h"
+#include "topology.h"
+
+NoiseBuffer::NoiseBuffer(int steps_arg) :
+	steps(steps_arg < 1 ? 1 : steps_arg), particles(0),
+	first_step(0), placement(nullptr), huge_pages(false),
+	stopping(false), produced(0), consumed(0), consumer_waits(false),
+	producer_waits(false), underruns(0), acquired(0)
+{
+}
+
+NoiseBuffer::~NoiseBuffer()
+{
+	stop();
+}
+
+void NoiseBuffer::stop()
+{
+	if (!producer.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping.store(true);
+	}
+	space.notify_one();
+	producer.join();
+	producer_waits.store(false);
+}
+
+void NoiseBuffer::start(const StreamGen &gen_arg, int particles_arg,
+	uint64_t step)
+{
+	stop();
+	gen = gen_arg;
+	particles = particles_arg;
+	first_step = step;
+	ring.resize((size_t) steps * particles);
+	if (placement != nullptr)
+		for (int s = 0; s < steps; ++s)
+			first_touch(&ring[(size_t) s * particles], particles,
+				*placement, huge_pages);
+	produced.store(step);
+	consumed.store(step);
+	underruns = 0;
+	acquired = 0;
+	stopping.store(false);
+	producer = std::thread(&NoiseBuffer::produce, this);
+	/* it inherits the mask of the pinned thread starting it */
+	cpu_set_t mask;
+	if (placement != nullptr && placement->spare_cpus(mask))
+		pthread_setaffinity_np(producer.native_handle(), sizeof(mask),
+			&mask);
+}
+
+bool NoiseBuffer::get_producer_affinity(cpu_set_t &mask)
+{
+	return producer.joinable() && pthread_getaffinity_np(
+		producer.native_handle(), sizeof(mask), &mask) == 0;
+}
+
+void NoiseBuffer::set_placement(ThreadPool *pool, bool huge_pages_arg)
+{
+	placement = pool;
+	huge_pages = huge_pages_arg;
+}
+
+void NoiseBuffer::produce()
+{
+	for (uint64_t step = first_step; !stopping.load(std::memory_order_relaxed);) {
+		if (step - consumed.load(std::memory_order_acquire) >= (uint64_t) steps) {
+			std::unique_lock<std::mutex> lock(mutex);
+			producer_waits.store(true);
+			space.wait(lock, [&] {
+				return stopping.load() ||
+					step - consumed.load() < (uint64_t) steps;
+			});
+			producer_waits.store(false);
+			continue;
+		}
+		const uint64_t key = gen.step_key(step);
+		Kernels::noise(key, 0, particles, slot(step));
+		/* seq_cst store, then load of the flag: see acquire */
+		produced.store(++step);
+		if (consumer_waits.load()) {
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.notify_one();
+		}
+	}
+}
+
+const Noise *NoiseBuffer::acquire(const StreamGen &gen_arg, int particles_arg,
+	uint64_t step)
+{
+	if (!producer.joinable() || gen_arg.get_seed() != gen.get_seed() ||
+			particles_arg != particles ||
+			step != consumed.load(std::memory_order_relaxed))
+		start(gen_arg, particles_arg, step);
+	++acquired;
+	if (produced.load(std::memory_order_acquire) <= step) {
+		++underruns;
+		/**
+		 * the flag is raised before @produced is checked again, and
+		 * the producer checks it after the store, so one of them
+		 * sees the other; the check and the sleep are under @mutex,
+		 * which the producer takes to notify
+		 */
+		std::unique_lock<std::mutex> lock(mutex);
+		consumer_waits.store(true);
+		ready.wait(lock, [&] { return produced.load() > step; });
+		consumer_waits.store(false);
+	}
+	return slot(step);
+}
+
+void NoiseBuffer::release()
+{
+	assert(consumed.load(std::memory_order_relaxed) <
+		produced.load(std::memory_order_relaxed));
+	consumed.fetch_add(1);
+	if (producer_waits.load()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		space.notify_one();
+	}
+}
@@ -0,0 +1,112 @@
+#include "profiler.h"
+
+static const char *phase_names[NUMBER_OF_PHASES] = {
+	"noise", "grid_update", "neighbours", "integration", "measurement"
+};
+
+static const char *counter_names[NUMBER_OF_COUNTERS] = {
+	"steps", "particle_steps", "queries", "neighbours",
+	"cells_visited", "boundary_cells", "cell_changes"
+};
+
+Profiler& Profiler::Instance()
+{
+	static Profiler theSingleInstance;
+	return theSingleInstance;
+}
+
+Profiler::Profiler() : peak_bandwidth(0)
+{
+	reset();
+}
+
+void Profiler::reset()
+{
+	for (int i = 0; i < NUMBER_OF_PHASES; ++i) {
+		phase_ticks[i] = 0;
+		phase_calls[i] = 0;
+	}
+	for (int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+		counters[i] = 0;
+	for (int i = 0; i < max_nodes; ++i)
+		node_bytes[i] = 0;
+	start_ticks = now();
+	start_time = std::chrono::steady_clock::now();
+}
+
+double Profiler::wall_seconds() const
+{
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start_time).count();
+}
+
+double Profiler::tick_rate() const
+{
+	double seconds = wall_seconds();
+	if (seconds <= 0)
+		return 1e9;
+	return (now() - start_ticks) / seconds;
+}
+
+static double ratio(long long num, long long den)
+{
+	return den == 0 ? 0 : (double) num / den;
+}
+
+void Profiler::print_summary(FILE *out) const
+{
+	double rate = tick_rate();
+	double wall = wall_seconds();
+	long long steps = counters[cnt_steps];
+	fprintf(out, "%-14s %12s %12s %14s %8s\n",
+		"phase", "calls", "cpu, s", "per step, ms", "% wall");
+	for (int i = 0; i < NUMBER_OF_PHASES; ++i) {
+		double seconds = phase_ticks[i] / rate;
+		fprintf(out, "%-14s %12llu %12.3lf %14.4lf %8.1lf\n",
+			phase_names[i], (unsigned long long) phase_calls[i],
+			seconds, steps ? 1e3 * seconds / steps : 0,
+			wall > 0 ? 100 * seconds / wall : 0);
+	}
+	fprintf(out, "wall time: %.3lf s, particle-steps/s: %.4g\n", wall,
+		wall > 0 ? counters[cnt_particle_steps] / wall : 0);
+	fprintf(out, "neighbours per query: %.2lf, cells per query: %.2lf "
+		"(%.2lf on boundary), cell changes per step: %.2lf\n",
+		ratio(counters[cnt_neighbours], counters[cnt_queries]),
+		ratio(counters[cnt_cells_visited], counters[cnt_queries]),
+		ratio(counters[cnt_boundary_cells], counters[cnt_queries]),
+		ratio(counters[cnt_cell_changes], steps));
+	for (int i = 0; i < max_nodes; ++i) {
+		if (node_bytes[i] == 0)
+			continue;
+		double gb_per_s = wall > 0 ? 1e-9 * node_bytes[i] / wall : 0;
+		fprintf(out, "NUMA node %d: modelled traffic %.3lf GB/s "
+			"(state arrays streamed by its threads)", i, gb_per_s);
+		if (peak_bandwidth > 0)
+			fprintf(out, ", %.1lf%% of stated peak %.1lf GB/s",
+				100 * gb_per_s / peak_bandwidth, peak_bandwidth);
+		fprintf(out, "\n");
+	}
+}
+
+void Profiler::dump_json(FILE *out, ld D_phi) const
+{
+	double rate = tick_rate();
+	fprintf(out, "{\"D_phi\": %lf, \"wall_seconds\": %lf, \"phases\": {",
+		D_phi, wall_seconds());
+	for (int i = 0; i < NUMBER_OF_PHASES; ++i)
+		fprintf(out, "%s\"%s\": {\"calls\": %llu, \"seconds\": %lf}",
+			i ? ", " : "", phase_names[i],
+			(unsigned long long) phase_calls[i], phase_ticks[i] / rate);
+	fprintf(out, "}, \"counters\": {");
+	for (int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+		fprintf(out, "%s\"%s\": %lld", i ? ", " : "",
+			counter_names[i], (long long) counters[i]);
+	int nodes = max_nodes;
+	while (nodes > 1 && node_bytes[nodes - 1] == 0)
+		--nodes;
+	fprintf(out, "}, \"modelled_node_bytes\": [");
+	for (int i = 0; i < nodes; ++i)
+		fprintf(out, "%s%lld", i ? ", " : "", (long long) node_bytes[i]);
+	fprintf(out, "], \"peak_node_gb_per_s\": %lf}\n", peak_bandwidth);
+	fflush(out);
+}
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <progress_reporter.h>
+
+ProgressReporter::ProgressReporter(FILE *out, double interval_arg) :
+	out(out), interval(interval_arg), stopping(false), active(false),
+	D_phi(0), steps(0), particles(0), done_steps(0),
+	order_requested(false), order(0), order_known(false)
+{
+	phase[0] = '\0';
+	thread = std::thread(&ProgressReporter::loop, this);
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+void ProgressReporter::start(const char *phase_arg, ld D_phi_arg,
+		int steps_arg, int particles_arg)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	strncpy(phase, phase_arg, sizeof(phase) - 1);
+	phase[sizeof(phase) - 1] = '\0';
+	D_phi = D_phi_arg;
+	steps = steps_arg;
+	particles = particles_arg;
+	started = std::chrono::steady_clock::now();
+	done_steps = 0;
+	order_known = false;
+	order_requested = true;
+	active = true;
+}
+
+void ProgressReporter::finish()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	report();
+	active = false;
+	order_requested = false;
+}
+
+void ProgressReporter::set_order(ld value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	order = value;
+	order_known = true;
+	order_requested = false;
+}
+
+void ProgressReporter::loop()
+{
+	typedef std::chrono::steady_clock clock;
+	std::unique_lock<std::mutex> lock(mutex);
+	clock::time_point next = clock::now();
+	while (!stopping) {
+		next += std::chrono::duration_cast<clock::duration>(interval);
+		while (!stopping && clock::now() < next)
+			wake.wait_until(lock, next);
+		if (stopping || !active)
+			continue;
+		report();
+		order_requested = true;
+	}
+}
+
+void ProgressReporter::report()
+{
+	int done = done_steps.load(std::memory_order_relaxed);
+	double elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - started).count();
+	double rate = elapsed > 0 ? (double) done * particles / elapsed : 0;
+	double eta = done > 0 ? elapsed * (steps - done) / done : -1;
+	fprintf(out, "progress phase=%s D_phi=%lf step=%d/%d elapsed=%.1lf "
+		"rate=%.3e eta=%.1lf", phase, D_phi, done, steps, elapsed,
+		rate, eta);
+	if (order_known)
+		fprintf(out, " order=%.4lf\n", order);
+	else
+		fprintf(out, " order=na\n");
+	fflush(out);
+}
@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "result_cache.h"
+
+void CacheKey::add(const char *name, ld value)
+{
+	char buf[64];
+	/* enough digits to tell any two doubles apart */
+	snprintf(buf, sizeof(buf), "%.17g", (double) value);
+	add(name, buf);
+}
+
+void CacheKey::add(const char *name, const char *value)
+{
+	key += name;
+	key += '=';
+	key += value;
+	key += ';';
+}
+
+uint64_t CacheKey::hash() const
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < key.size(); ++i) {
+		h ^= (unsigned char) key[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+ResultCache::ResultCache(const char *directory, const char *version) :
+	directory(directory), version(version), hits(0), misses(0)
+{
+	/* may exist already */
+	mkdir(directory, 0755);
+}
+
+CacheKey ResultCache::versioned(const CacheKey &key) const
+{
+	CacheKey result = key;
+	result.add("version", version.c_str());
+	return result;
+}
+
+std::string ResultCache::file_name(const CacheKey &key) const
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "/%016llx",
+		(unsigned long long) key.hash());
+	return directory + buf;
+}
+
+bool ResultCache::lookup(const CacheKey &key_arg, std::vector<ld> &values)
+{
+	const CacheKey key = versioned(key_arg);
+	FILE *in = fopen(file_name(key).c_str(), "rt");
+	if (in == NULL) {
+		++misses;
+		return false;
+	}
+	std::string stored;
+	int c;
+	while ((c = fgetc(in)) != EOF && c != '\n')
+		stored += (char) c;
+	bool found = stored == key.text();
+	values.clear();
+	double value;
+	while (found && fscanf(in, "%lf", &value) == 1)
+		values.push_back(value);
+	fclose(in);
+	/* truncated or edited record */
+	if (!found || values.empty()) {
+		++misses;
+		return false;
+	}
+	++hits;
+	return true;
+}
+
+bool ResultCache::store(const CacheKey &key_arg,
+	const std::vector<ld> &values)
+{
+	const CacheKey key = versioned(key_arg);
+	const std::string name = file_name(key);
+	/* written aside and renamed, so readers never see a half */
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%d.tmp", (int) getpid());
+	const std::string temp = name + suffix;
+	FILE *out = fopen(temp.c_str(), "wt");
+	if (out == NULL)
+		return false;
+	fprintf(out, "%s\n", key.text().c_str());
+	for (size_t i = 0; i < values.size(); ++i)
+		fprintf(out, "%s%.17g", i > 0 ? "\t" : "", (double) values[i]);
+	fprintf(out, "\n");
+	if (fclose(out) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	return rename(temp.c_str(), name.c_str()) == 0;
+}
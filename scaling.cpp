@@ -0,0 +1,212 @@
+/**
+ * End-to-end scaling of Cluster steps:
+ *   strong - N and L are fixed, threads are 1, 2, 4, ... @max_threads;
+ *   weak - N grows with threads, L so that density N / L^2 is fixed;
+ * for local visibility with grid and with straightforward search
+ * and for global visibility. Only the parallel engine uses threads,
+ * straightforward search has only serial engine, so it's measured
+ * with 1 thread as the baseline.
+ * Results: scaling.csv and scaling.json, see scaling.gnuplot
+ *
+ * usage: ./scaling [N [rectangle_size [epsilon [steps [max_threads]]]]]
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <gaussian_gen.h>
+#include <cluster.h>
+
+using namespace std;
+
+namespace {
+	/* a model in the ordered phase, its cost is the same as any */
+	Model model;
+
+	Point heun_speed(Point v0, Point u_A)
+	{
+		Noise xi;
+		xi.x = GaussianGen::Instance().value(i_x);
+		xi.y = GaussianGen::Instance().value(i_y);
+		xi.v = GaussianGen::Instance().value(i_v);
+		xi.phi = GaussianGen::Instance().value(i_phi);
+		return model.heun_speed(v0, u_A, xi);
+	}
+
+	Point heun_position(Point r, Point v)
+	{
+		return r + v * model.h;
+	}
+
+	struct Case {
+		const char *visibility;
+		const char *backend;
+		bool local;
+		bool grid;
+		/* Cluster::evolve_parallel, Cluster::evolve otherwise */
+		bool parallel;
+	};
+
+	const Case cases[] = {
+		{ "local", "grid", true, true, true },
+		{ "local", "naive", true, false, false },
+		{ "global", "mean_field", false, false, true },
+	};
+
+	struct Row {
+		const char *mode;
+		const Case *test;
+		int threads;
+		int N;
+		ld L;
+		int steps;
+		double seconds;
+		double speedup;
+		double efficiency;
+	};
+}
+
+/* seconds of @steps steps after warm-up */
+static double measure(const Case &test, int N, ld L, ld epsilon,
+	int threads, int steps)
+{
+	const int warmup = 5;
+	Cluster cluster(N, L, test.local, epsilon, test.grid);
+	cluster.set_threads(threads);
+	cluster.set_model(model);
+	cluster.set_noise_seed(1);
+	cluster.seed_from_noise(-1, 1);
+	auto step = [&] () {
+		if (test.parallel)
+			cluster.evolve_parallel();
+		else
+			cluster.evolve(heun_speed, heun_position);
+	};
+	for (int it = 0; it < warmup; ++it)
+		step();
+	auto start = chrono::steady_clock::now();
+	for (int it = 0; it < steps; ++it)
+		step();
+	return chrono::duration<double>(chrono::steady_clock::now() -
+			start).count();
+}
+
+static void write_csv(const char *name, const vector<Row> &rows)
+{
+	FILE *out = fopen(name, "wt");
+	if (out == NULL) {
+		printf("can't open %s to write\n", name);
+		return;
+	}
+	fprintf(out, "mode,visibility,backend,threads,N,L,steps,seconds,"
+		"particle_steps_per_second,speedup,efficiency\n");
+	for (size_t i = 0; i < rows.size(); ++i) {
+		const Row &row = rows[i];
+		fprintf(out, "%s,%s,%s,%d,%d,%lf,%d,%lf,%lf,%lf,%lf\n",
+			row.mode, row.test->visibility, row.test->backend,
+			row.threads, row.N, row.L, row.steps, row.seconds,
+			(double) row.N * row.steps / row.seconds,
+			row.speedup, row.efficiency);
+	}
+	fclose(out);
+}
+
+static void write_json(const char *name, const vector<Row> &rows)
+{
+	FILE *out = fopen(name, "wt");
+	if (out == NULL) {
+		printf("can't open %s to write\n", name);
+		return;
+	}
+	fprintf(out, "[\n");
+	for (size_t i = 0; i < rows.size(); ++i) {
+		const Row &row = rows[i];
+		fprintf(out, "{\"mode\": \"%s\", \"visibility\": \"%s\", "
+			"\"backend\": \"%s\", \"threads\": %d, \"N\": %d, "
+			"\"L\": %lf, \"steps\": %d, \"seconds\": %lf, "
+			"\"particle_steps_per_second\": %lf, \"speedup\": %lf, "
+			"\"efficiency\": %lf}%s\n", row.mode,
+			row.test->visibility, row.test->backend, row.threads,
+			row.N, row.L, row.steps, row.seconds,
+			(double) row.N * row.steps / row.seconds, row.speedup,
+			row.efficiency, i + 1 < rows.size() ? "," : "");
+	}
+	fprintf(out, "]\n");
+	fclose(out);
+}
+
+int main(int argc, char const *argv[])
+{
+	int N = argc > 1 ? atoi(argv[1]) : 10000;
+	ld L = argc > 2 ? atof(argv[2]) : 10;
+	ld epsilon = argc > 3 ? atof(argv[3]) : 0.1;
+	int steps = argc > 4 ? atoi(argv[4]) : 20;
+	int max_threads = argc > 5 ? atoi(argv[5]) :
+		max(1u, thread::hardware_concurrency());
+	if (N < 1 || L <= 2 * epsilon || epsilon <= 0 || steps < 1 ||
+			max_threads < 1) {
+		printf("usage: %s [N [rectangle_size [epsilon [steps "
+			"[max_threads]]]]]\n", argv[0]);
+		return -1;
+	}
+	model.mu = 1;
+	model.h = 0.005;
+	model.sqrt_h = sqrt(model.h);
+	model.sqrt2_D_E = sqrt(2 * 0.01);
+	model.sqrt2_D_v = 0;
+	model.sqrt2_D_phi = sqrt(2 * 0.05);
+	model.scheme = scheme_heun;
+
+	vector<int> thread_counts;
+	for (int t = 1; t < max_threads; t *= 2)
+		thread_counts.push_back(t);
+	thread_counts.push_back(max_threads);
+
+	const char *modes[] = { "strong", "weak" };
+	vector<Row> rows;
+	printf("%-7s %-7s %-11s %8s %9s %10s %10s %8s %8s\n", "mode",
+		"vis.", "backend", "threads", "N", "L", "seconds",
+		"speedup", "effic.");
+	for (int m = 0; m < 2; ++m) {
+		const bool weak = m == 1;
+		for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+			const Case &test = cases[c];
+			double base = 0;
+			for (size_t k = 0; k < thread_counts.size(); ++k) {
+				const int threads = thread_counts[k];
+				if (!test.parallel && threads > 1)
+					break;
+				Row row;
+				row.mode = modes[m];
+				row.test = &test;
+				row.threads = threads;
+				row.N = weak ? N * threads : N;
+				row.L = weak ? L * sqrt((ld) threads) : L;
+				row.steps = steps;
+				row.seconds = measure(test, row.N, row.L, epsilon,
+					threads, steps);
+				if (threads == 1)
+					base = row.seconds;
+				/* weak: time should stay the same for more work */
+				double ratio = base / row.seconds;
+				row.speedup = weak ? ratio * threads : ratio;
+				row.efficiency = weak ? ratio : ratio / threads;
+				printf("%-7s %-7s %-11s %8d %9d %10.3lf %10.3lf "
+					"%8.2lf %8.2lf\n", row.mode, test.visibility,
+					test.backend, threads, row.N, row.L,
+					row.seconds, row.speedup, row.efficiency);
+				fflush(stdout);
+				rows.push_back(row);
+			}
+		}
+	}
+	write_csv("scaling.csv", rows);
+	write_json("scaling.json", rows);
+	puts("results are put to scaling.csv and scaling.json, "
+		"plot them by gnuplot scaling.gnuplot");
+	return 0;
+}
@@ -0,0 +1,37 @@
+# plots scaling.csv of ./scaling (make scaling): speedup of strong
+# scaling and efficiency of weak scaling by threads
+set term postscript eps enhanced
+set output "scaling.eps"
+set datafile separator ","
+set key top left
+set xlabel "threads"
+set logscale x 2
+
+row(mode, vis, backend, c) = (strcol(1) eq mode && strcol(2) eq vis && \
+	strcol(3) eq backend) ? column(c) : 1/0
+
+set multiplot layout 1,2
+
+set title "strong scaling, fixed N"
+set ylabel "speedup"
+plot 'scaling.csv' every ::1 using 4:(row("strong", "local", "grid", 10)) \
+		w lp title "local, grid", \
+	'scaling.csv' every ::1 using 4:(row("strong", "local", "naive", 10)) \
+		w p pt 7 title "local, naive (serial)", \
+	'scaling.csv' every ::1 using 4:(row("strong", "global", "mean_field", 10)) \
+		w lp title "global", \
+	x w l lt 0 title "ideal"
+
+set title "weak scaling, N / threads and density fixed"
+set ylabel "efficiency"
+set yrange [0:1.2]
+plot 'scaling.csv' every ::1 using 4:(row("weak", "local", "grid", 11)) \
+		w lp title "local, grid", \
+	'scaling.csv' every ::1 using 4:(row("weak", "local", "naive", 11)) \
+		w p pt 7 title "local, naive (serial)", \
+	'scaling.csv' every ::1 using 4:(row("weak", "global", "mean_field", 11)) \
+		w lp title "global", \
+	1 w l lt 0 title "ideal"
+
+unset multiplot
+exit
@@ -1,19 +1,44 @@
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <chrono>
 
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <algorithm>
 
 #include <err.h>
 
 #include <gaussian_gen.h>
 #include <point.h>
+#include <model.h>
 #include <cluster.h>
 #include <luautils.h>
 #include <progressbar.h>
+#include <progress_reporter.h>
+#include <step_controller.h>
+#include <profiler.h>
+#include <thread_pool.h>
+#include <sweep.h>
+#include <result_cache.h>
+#include <transition_search.h>
+#include <kernels.h>
+#include <autotuner.h>
+#include <topology.h>
+#ifdef WITH_MPI
+#include <mpi.h>
+#include <domain.h>
+#endif
 
 using namespace std;
 
+/* part of result cache keys, see params::cache_version */
+#ifndef CODE_VERSION
+#define CODE_VERSION "unknown"
+#endif
+
 namespace params {
 	int relaxation_iterations 	= 5;
 	int iterations 				= 400 * 1000;
@@ -26,6 +51,8 @@ namespace params {
 	bool local_visibility = true;
 	ld epsilon = 1;
 	bool use_grid = false;
+	/* approximate alignment field on mesh of @mesh_cells^2 cells, if > 0 */
+	int mesh_cells = 0;
 	ld mu = 2.5;
 	ld D_E = 0.05;
 	ld D_v = 0;
@@ -42,8 +69,93 @@ namespace params {
 	ld D_phi_end 	= 0.30;
 	ld D_phi_step	= 0.01;
 	ld D_phi_log_step = -1;
+	/**
+	 * after the range, the steepest interval of order parameter is
+	 * bisected until it's not wider than @D_phi_resolution (if > 0),
+	 * @D_phi_max_points are measured at most, see TransitionSearch
+	 */
+	ld D_phi_resolution = 0;
+	int D_phi_max_points = 100;
 	ld speed_lowest 	= -1.0;
 	ld speed_highest	= 1.0;
+	int threads = 1;
+	/**
+	 * @parallel_engine: use Cluster::evolve_parallel (counter-based
+	 * noise, all threads) instead of heun_speed/heun_position
+	 */
+	bool parallel_engine = false;
+	/**
+	 * @distributed_engine: box is split between MPI ranks (see Domain),
+	 * needs local visibility and build by `make mpi`
+	 */
+	bool distributed_engine = false;
+	int seed = 0;
+	/* renumber particles along Morton curve every @reorder_interval steps */
+	int reorder_interval = 0;
+	/* noise of parallel engine is generated @noise_buffer steps ahead */
+	int noise_buffer = 0;
+	/* parallel engine keeps positions in 32-bit fixed point */
+	bool fixed_positions = false;
+	/**
+	 * grid has @cells_per_epsilon cells per epsilon, tiles of tiled
+	 * step are @tile_cells cells wide (0 - default), see Cluster
+	 */
+	int cells_per_epsilon = 5;
+	int tile_cells = 0;
+	/**
+	 * @tuning_mode: "off", "load" - parameters tuned for this machine
+	 * and class of system are taken from @tuning_file, if it has them,
+	 * "auto" - also they're tuned and stored there if it hasn't
+	 */
+	char tuning_mode[16] = "off";
+	char tuning_file[256] = "tuning.txt";
+	/* tuned parameters replaced configured ones, see tune() */
+	bool tuned = false;
+	/**
+	 * @pinning: "none", "compact" or "scatter" placement of threads
+	 * of parallel engine on CPUs (see Topology), their arrays are
+	 * then first touched by the threads working on them, on huge
+	 * pages if @huge_pages; sweep jobs aren't pinned
+	 */
+	char pinning[16] = "none";
+	bool huge_pages = false;
+	/* GB/s of one NUMA node, profile compares modelled traffic with it */
+	ld peak_bandwidth = 0;
+	/**
+	 * relaxation with adaptive time step, if @adaptive_tolerance > 0:
+	 * local error per step is kept about it, step is in [h, @max_time_step]
+	 */
+	ld adaptive_tolerance = 0;
+	ld max_time_step = 0;
+	/* velocity integration scheme of parallel engine */
+	scheme_id scheme = scheme_heun;
+	/**
+	 * if > 0, every D_phi point is measured once more by Heun scheme
+	 * with this time step over the same time, to compare with
+	 */
+	ld reference_time_step = 0;
+	/**
+	 * @progress_output: "stderr", "stdout" or name of file
+	 * for ProgressReporter lines; empty means ASCII ProgressBar
+	 */
+	char progress_output[256] = "";
+	ld progress_interval = 10;
+	/**
+	 * @sweep: if set, its points are simulated instead of D_phi range,
+	 * @sweep_jobs of them at once, the most expensive first
+	 */
+	Sweep *sweep = NULL;
+	int sweep_jobs = 1;
+	/* local order at the end of every point is reported for these */
+	std::vector<ld> local_order_radii;
+	/**
+	 * @cache_directory: if set, measured points are stored there and
+	 * taken from there instead of simulating them again;
+	 * @cache_version is a part of every key, changing it (by default
+	 * it's commit of the build) invalidates everything stored before
+	 */
+	char cache_directory[256] = "";
+	char cache_version[64] = CODE_VERSION;
 
 	void set_D_E(const ld& nval)
 	{
@@ -70,6 +182,188 @@ namespace params {
 		sqrt_h = sqrt(h);
 	}
 
+	Model model()
+	{
+		Model m;
+		m.mu = mu;
+		m.h = h;
+		m.sqrt_h = sqrt_h;
+		m.sqrt2_D_E = sqrt2_D_E;
+		m.sqrt2_D_v = sqrt2_D_v;
+		m.sqrt2_D_phi = sqrt2_D_phi;
+		m.scheme = scheme;
+		return m;
+	}
+
+	/* the point of current D_phi */
+	SweepPoint base_point()
+	{
+		SweepPoint point = { N, epsilon, mu, D_E, D_phi, 0, 0 };
+		return point;
+	}
+
+	/* the physical system of @point: model, its integration and box */
+	CacheKey physics_key(const SweepPoint &point)
+	{
+		CacheKey key;
+		key.add("scheme", scheme == scheme_split ? "split" : "heun");
+		key.add("N", point.N);
+		key.add("L", L_size);
+		key.add("local_visibility", local_visibility);
+		key.add("epsilon", local_visibility ? point.epsilon : 0);
+		key.add("mu", point.mu);
+		key.add("D_E", point.D_E);
+		key.add("D_v", D_v);
+		key.add("D_phi", point.D_phi);
+		key.add("h", h);
+		return key;
+	}
+
+	/**
+	 * point_key - everything the result at @point depends on, except
+	 * of seed; performance parameters are in it only if they change
+	 * bits of results: grid resolution changes order of summation
+	 * in disc, reordering changes order of summation as well and
+	 * order of global noise of serial engine; threads and tiles
+	 * of parallel one don't. Results of tuned runs are kept apart
+	 * (key has "tuned"), so tuning a machine neither reuses nor
+	 * shadows results of runs with configured parameters
+	 */
+	CacheKey point_key(const SweepPoint &point)
+	{
+		CacheKey key = physics_key(point);
+		if (tuned)
+			key.add("tuned", "yes");
+		key.add("engine", parallel_engine ? "parallel" : "serial");
+		key.add("use_grid", use_grid);
+		key.add("mesh_cells", mesh_cells);
+		key.add("relaxation_iterations", relaxation_iterations);
+		key.add("iterations", iterations);
+		key.add("adaptive_tolerance", adaptive_tolerance);
+		key.add("max_time_step", max_time_step);
+		key.add("reorder_interval", reorder_interval);
+		key.add("fixed_positions", fixed_positions);
+		key.add("cells_per_epsilon", use_grid ? cells_per_epsilon : 0);
+		key.add("speed_lowest", speed_lowest);
+		key.add("speed_highest", speed_highest);
+		key.add("reference_time_step", reference_time_step);
+		return key;
+	}
+
+	/**
+	 * noise_seed - seed of counter-based noise for @point:
+	 * it depends on @seed and physics of the point only, not on its
+	 * place in the sweep or on performance parameters, so overlapping
+	 * sweeps and differently tuned machines repeat each other
+	 */
+	uint64_t noise_seed(const SweepPoint &point)
+	{
+		return ((uint64_t) seed << 32) +
+			(uint32_t) physics_key(point).hash();
+	}
+
+	Model model_of(const SweepPoint &point)
+	{
+		Model m = model();
+		m.mu = point.mu;
+		m.sqrt2_D_E = sqrt(2 * point.D_E);
+		m.sqrt2_D_phi = sqrt(2 * point.D_phi);
+		return m;
+	}
+
+	/* D_phi range of config as list */
+	std::vector<ld> D_phi_values()
+	{
+		std::vector<ld> values;
+		for (ld d = D_phi_start; d <= D_phi_end + 1e-7;
+				d = D_phi_log_step > 0 ? d * D_phi_log_step :
+				d + D_phi_step)
+			values.push_back(d);
+		return values;
+	}
+
+	const char *sweep_names[] = { "number_of_particles", "epsilon", "mu",
+		"passive_noise", "angular_noise" };
+	const int sweep_names_number = 5;
+
+	/* @returns false and tells why if swept @name can't be @value */
+	bool check_sweep_value(const char *name, ld value)
+	{
+		if (strcmp(name, "number_of_particles") == 0 && value < 1) {
+			printf("sweep: number_of_particles must be positive\n");
+			return false;
+		}
+		if (strcmp(name, "epsilon") == 0 && local_visibility &&
+				(value <= 0 || 2 * value >= L_size)) {
+			printf("sweep: epsilon must be in (0, rectangle_size / 2)\n");
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * load_sweep - optional table @sweep of config: @axes (name = list
+	 * of values, Cartesian product is run) or @points (list of tables
+	 * name = value, D_phi is angular_noise.start if not set); without
+	 * @points D_phi range is an axis unless @axes has angular_noise
+	 * @returns 0 if ok, -1 otherwise
+	 */
+	int load_sweep(lua_State *L)
+	{
+		if (!lua_boolexpr(L, "sweep ~= nil"))
+			return 0;
+		if (!parallel_engine || adaptive_tolerance > 0 ||
+				reference_time_step > 0) {
+			printf("sweep needs parallel engine with fixed time step\n");
+			return -1;
+		}
+		sweep = new Sweep(base_point());
+		char expr[128];
+		int count = 0;
+		if (lua_intexpr(L, "#(sweep.points or {})", &count) && count > 0) {
+			for (int i = 1; i <= count; ++i) {
+				std::vector<std::pair<std::string, ld> > values;
+				for (int k = 0; k < sweep_names_number; ++k) {
+					ld value;
+					sprintf(expr, "sweep.points[%d].%s", i, sweep_names[k]);
+					if (!lua_numberexpr(L, expr, &value))
+						continue;
+					if (!check_sweep_value(sweep_names[k], value))
+						return -1;
+					values.push_back(std::make_pair(
+						std::string(sweep_names[k]), value));
+				}
+				sweep->add_point(values);
+			}
+			printf("sweep over %d points\n", count);
+		} else {
+			for (int k = 0; k < sweep_names_number; ++k) {
+				sprintf(expr, "#((sweep.axes or {}).%s or {})",
+					sweep_names[k]);
+				if (!lua_intexpr(L, expr, &count) || count == 0)
+					continue;
+				std::vector<ld> values(count);
+				for (int i = 0; i < count; ++i) {
+					sprintf(expr, "sweep.axes.%s[%d]", sweep_names[k],
+						i + 1);
+					if (lua_numberexpr(L, expr, &values[i]) == 0 ||
+							!check_sweep_value(sweep_names[k], values[i]))
+						return -1;
+				}
+				sweep->add_axis(sweep_names[k], values);
+				printf("sweep axis %s: %d values\n", sweep_names[k], count);
+			}
+			if (!sweep->has_axis("angular_noise"))
+				sweep->add_axis("angular_noise", D_phi_values());
+		}
+		sweep_jobs = threads;
+		lua_intexpr(L, "sweep.jobs", &sweep_jobs);
+		if (sweep_jobs < 1)
+			sweep_jobs = 1;
+		printf("sweep runs %d jobs at once\n", sweep_jobs);
+		return 0;
+	}
+
 	/* @returns 0 if ok, -1 otherwise */
 	int load_params(const char *file_name) {
 		ld temp;
@@ -103,13 +397,178 @@ namespace params {
 				return -1;
 			printf("local visibility with epsilon: %lf\n", epsilon);
 			use_grid = lua_boolexpr(L, "integration.use_grid");
-			if (use_grid)
+			lua_intexpr(L, "integration.mesh_cells", &mesh_cells);
+			if (mesh_cells > 0)
+				printf("speed in disc will be approximated on mesh "
+					"%dx%d\n", mesh_cells, mesh_cells);
+			else if (use_grid)
 				puts("speed in disc will be calculated with grid (spatial partition)");
 			else
 				puts("speed in disc will be calculated with straightforward approach");
 		} else {
 			printf("global visibility\n");
 		}
+		const char *engine = lua_stringexpr(L, "integration.engine",
+				"serial");
+		parallel_engine = strcmp(engine, "parallel") == 0;
+		distributed_engine = strcmp(engine, "distributed") == 0;
+		if (distributed_engine) {
+#ifndef WITH_MPI
+			printf("distributed engine needs build with MPI (make mpi)\n");
+			return -1;
+#endif
+			if (!local_visibility) {
+				printf("distributed engine needs local visibility\n");
+				return -1;
+			}
+			puts("distributed engine is used");
+		}
+		if (parallel_engine) {
+			if (local_visibility && (!use_grid || mesh_cells > 0)) {
+				printf("parallel engine needs grid for local visibility\n");
+				return -1;
+			}
+			/* periodic images of a neighbour must not both be in disc */
+			if (local_visibility && 2 * epsilon >= L_size) {
+				printf("parallel engine needs 2 * epsilon < rectangle_size\n");
+				return -1;
+			}
+			puts("parallel engine is used");
+		}
+		lua_intexpr(L, "integration.threads", &threads);
+		printf("threads: %d\n", threads);
+		const char *isa_name = lua_stringexpr(L, "integration.isa", "auto");
+		isa_id isa = Kernels::detect();
+		if (strcmp(isa_name, "auto") != 0) {
+			if (!Kernels::parse(isa_name, isa)) {
+				printf("unknown instruction set '%s'\n", isa_name);
+				return -1;
+			}
+			if (!Kernels::supported(isa)) {
+				printf("instruction set %s isn't supported by CPU\n",
+					isa_name);
+				return -1;
+			}
+		}
+		Kernels::select(isa);
+		printf("vector kernels: %s (CPU supports up to %s)\n",
+			Kernels::name(isa), Kernels::name(Kernels::detect()));
+		lua_intexpr(L, "integration.seed", &seed);
+		printf("seed: %d\n", seed);
+		lua_intexpr(L, "integration.reorder_interval", &reorder_interval);
+		if (reorder_interval > 0)
+			printf("particles are reordered every %d steps\n",
+				reorder_interval);
+		lua_intexpr(L, "integration.noise_buffer", &noise_buffer);
+		if (parallel_engine && noise_buffer > 0)
+			printf("noise is generated %d steps ahead\n", noise_buffer);
+		fixed_positions = lua_boolexpr(L, "integration.fixed_positions");
+		if (fixed_positions) {
+			if (!parallel_engine || !local_visibility) {
+				printf("fixed-point positions need parallel engine "
+					"and local visibility\n");
+				return -1;
+			}
+			puts("positions are kept in 32-bit fixed point");
+		}
+		strncpy(pinning, lua_stringexpr(L, "integration.pinning", "none"),
+				sizeof(pinning) - 1);
+		huge_pages = lua_boolexpr(L, "integration.huge_pages");
+		if (strcmp(pinning, "none") != 0) {
+			std::vector<int> cpus;
+			if (!Topology::Instance().placement(pinning, 1, cpus)) {
+				printf("unknown pinning '%s'\n", pinning);
+				return -1;
+			}
+			if (!parallel_engine) {
+				printf("pinning needs parallel engine\n");
+				return -1;
+			}
+			printf("threads are pinned %s to %d CPUs of %d NUMA "
+				"nodes%s\n", pinning, Topology::Instance().cpus(),
+				Topology::Instance().nodes(),
+				huge_pages ? ", arrays are on huge pages" : "");
+		} else if (huge_pages) {
+			printf("huge pages need pinning\n");
+			return -1;
+		}
+		lua_numberexpr(L, "integration.peak_bandwidth", &peak_bandwidth);
+		if (peak_bandwidth < 0) {
+			printf("peak_bandwidth can't be negative\n");
+			return -1;
+		}
+		lua_intexpr(L, "integration.cells_per_epsilon", &cells_per_epsilon);
+		lua_intexpr(L, "integration.tile_cells", &tile_cells);
+		if (cells_per_epsilon < 1 || tile_cells < 0) {
+			printf("cells_per_epsilon must be positive, "
+				"tile_cells non-negative\n");
+			return -1;
+		}
+		strncpy(tuning_mode, lua_stringexpr(L, "tuning.mode", "off"),
+				sizeof(tuning_mode) - 1);
+		if (strcmp(tuning_mode, "off") != 0) {
+			if (strcmp(tuning_mode, "load") != 0 &&
+					strcmp(tuning_mode, "auto") != 0) {
+				printf("unknown tuning mode '%s'\n", tuning_mode);
+				return -1;
+			}
+			if (!parallel_engine || !local_visibility) {
+				printf("tuning needs parallel engine "
+					"and local visibility\n");
+				return -1;
+			}
+			const char *file = lua_stringexpr(L, "tuning.file", NULL);
+			if (file != NULL)
+				strncpy(tuning_file, file, sizeof(tuning_file) - 1);
+			printf("tuned parameters: %s, mode %s\n", tuning_file,
+				tuning_mode);
+		}
+		lua_numberexpr(L, "integration.adaptive.tolerance",
+				&adaptive_tolerance);
+		if (adaptive_tolerance > 0) {
+			if (!parallel_engine) {
+				printf("adaptive time step needs parallel engine\n");
+				return -1;
+			}
+			max_time_step = 10 * h;
+			lua_numberexpr(L, "integration.adaptive.max_time_step",
+					&max_time_step);
+			printf("relaxation time step is adaptive: tolerance %lf, "
+				"h up to %lf\n", adaptive_tolerance, max_time_step);
+		}
+		const char *scheme_name = lua_stringexpr(L, "integration.scheme",
+				"heun");
+		if (strcmp(scheme_name, "split") == 0) {
+			if (!(parallel_engine || distributed_engine) ||
+					adaptive_tolerance > 0) {
+				printf("split scheme needs parallel or distributed "
+					"engine and fixed time step\n");
+				return -1;
+			}
+			scheme = scheme_split;
+			puts("velocity is integrated by operator splitting");
+		} else if (strcmp(scheme_name, "heun") != 0) {
+			printf("unknown integration scheme '%s'\n", scheme_name);
+			return -1;
+		}
+		lua_numberexpr(L, "integration.reference_time_step",
+				&reference_time_step);
+		if (reference_time_step > 0) {
+			/* serial engine integrates by params, not by Model */
+			if (!parallel_engine) {
+				printf("reference time step needs parallel engine\n");
+				return -1;
+			}
+			printf("every point is compared with Heun scheme at "
+				"h = %lf\n", reference_time_step);
+		}
+		strncpy(progress_output, lua_stringexpr(L, "progress.output", ""),
+				sizeof(progress_output) - 1);
+		if (progress_output[0] != '\0') {
+			lua_numberexpr(L, "progress.interval", &progress_interval);
+			printf("progress is reported to %s every %lf s\n",
+				progress_output, progress_interval);
+		}
 		if (lua_numberexpr(L, "model.mu", &mu) == 0)
 			return -1;
 		printf("mu: %lf\n", mu);
@@ -139,6 +598,17 @@ namespace params {
 		} else {
 			printf("D_phi in [%lf, %lf] with logarithmic step %lf\n", D_phi_start, D_phi_end, D_phi_log_step);
 		}
+		lua_numberexpr(L,
+				"model.noise_intensities.angular_noise.refine.resolution",
+				&D_phi_resolution);
+		if (D_phi_resolution > 0) {
+			lua_intexpr(L,
+				"model.noise_intensities.angular_noise.refine.max_points",
+				&D_phi_max_points);
+			printf("D_phi is refined around transition up to %lf, "
+				"%d points at most\n", D_phi_resolution,
+				D_phi_max_points);
+		}
 		set_D_phi(D_phi_start);
 		if (lua_numberexpr(L, "model.speed.lowest", &speed_lowest) == 0)
 			return -1;
@@ -146,82 +616,444 @@ namespace params {
 			return -1;
 		printf("initial speeds in [%lf, %lf]\n",
 			speed_lowest, speed_highest);
+		if (load_sweep(L) != 0)
+			return -1;
+		int radii = 0;
+		lua_intexpr(L, "#((observables or {}).local_order_radii or {})",
+				&radii);
+		local_order_radii.resize(radii);
+		for (int j = 0; j < radii; ++j) {
+			char expr[64];
+			sprintf(expr, "observables.local_order_radii[%d]", j + 1);
+			if (lua_numberexpr(L, expr, &local_order_radii[j]) == 0)
+				return -1;
+			if ((j > 0 && local_order_radii[j] <= local_order_radii[j - 1])
+					|| 2 * local_order_radii[j] >= L_size) {
+				printf("local order radii must ascend and be less "
+					"than half of rectangle_size\n");
+				return -1;
+			}
+		}
+		if (radii > Grid::max_radii) {
+			printf("no more than %d local order radii\n", Grid::max_radii);
+			return -1;
+		}
+		if (radii > 0)
+			printf("local order is measured for %d radii\n", radii);
+		strncpy(cache_directory, lua_stringexpr(L, "cache.directory", ""),
+				sizeof(cache_directory) - 1);
+		if (cache_directory[0] != '\0') {
+			const char *version = lua_stringexpr(L, "cache.version",
+					NULL);
+			if (version != NULL)
+				strncpy(cache_version, version,
+					sizeof(cache_version) - 1);
+			printf("results are cached in %s, version '%s'\n",
+				cache_directory, cache_version);
+		}
 		lua_close(L);
 		return 0;
 	}
 };
 
-inline Point f(Point v, Point u_A)
+Point heun_speed(Point v0, Point u_A)
 {
-	Point e_iv = v.get_unit();;
-	return e_iv - v + params::mu * (u_A - v);
+	Noise xi;
+	{
+		PROFILE_SCOPE(ph_noise);
+		xi.x = GaussianGen::Instance().value(i_x);
+		xi.y = GaussianGen::Instance().value(i_y);
+		xi.v = GaussianGen::Instance().value(i_v);
+		xi.phi = GaussianGen::Instance().value(i_phi);
+	}
+	return params::model().heun_speed(v0, u_A, xi);
 }
 
-inline Point g_E()
+Point heun_position(Point r, Point v)
 {
-	return params::sqrt2_D_E * Point(1, 1);
+	return r + v * params::rh;
 }
 
-inline Point g_v(Point v)
+void evolve(Cluster &cluster)
 {
-	return params::sqrt2_D_v * v.get_unit();
+	if (params::parallel_engine)
+		cluster.evolve_parallel();
+	else
+		cluster.evolve(heun_speed, heun_position);
 }
 
-inline Point g_phi(Point v)
+/**
+ * Progress of one phase (relaxation or observation)
+ * is shown by @reporter if it's set, by @bar otherwise
+ */
+class Progress {
+public:
+	Progress(ProgressReporter *reporter) : reporter(reporter) {}
+	void start(const char *phase, int steps)
+	{
+		if (reporter != NULL) {
+			reporter->start(phase, params::D_phi, steps, params::N);
+		} else {
+			printf("%s", phase);
+			bar.start(steps);
+		}
+	}
+	void check_and_move(int it, const Cluster &cluster)
+	{
+		if (reporter != NULL) {
+			reporter->advance(it + 1);
+			if (reporter->wants_order())
+				reporter->set_order(cluster.get_avg_speed_val());
+		} else {
+			bar.check_and_move(it);
+		}
+	}
+	/* the same as @check_and_move, but @it may jump forward */
+	void move_to(int it, const Cluster &cluster)
+	{
+		if (reporter != NULL)
+			check_and_move(it, cluster);
+		else
+			bar.moveTo(it + 1);
+	}
+	void finish()
+	{
+		if (reporter != NULL)
+			reporter->finish();
+		else
+			bar.finish_successfully();
+	}
+private:
+	ProgressReporter *reporter;
+	ProgressBar bar;
+};
+
+void run_phase(Cluster &cluster, Progress &progress, const char *phase,
+		int steps)
 {
-	return params::sqrt2_D_phi * v.get_unit().get_normal();
+	progress.start(phase, steps);
+	for (int it = 0; it < steps; ++it) {
+		evolve(cluster);
+		progress.check_and_move(it, cluster);
+	}
+	progress.finish();
 }
 
-Point heun_speed(Point v0, Point u_A)
+/**
+ * relax - relaxation for @relaxation_iterations fixed steps or,
+ * if time step is adaptive, for the same time with steps
+ * chosen by StepController
+ */
+void relax(Cluster &cluster, Progress &progress)
 {
-	ld xi_x = GaussianGen::Instance().value(i_x);
-	ld xi_y = GaussianGen::Instance().value(i_y);
-	Point xi_E(xi_x, xi_y);
-
-	ld xi_v = GaussianGen::Instance().value(i_v);
-	ld xi_phi = GaussianGen::Instance().value(i_phi);
+	const int iterations = params::relaxation_iterations;
+	if (params::adaptive_tolerance <= 0) {
+		run_phase(cluster, progress, "relaxation", iterations);
+		return;
+	}
+	progress.start("relaxation", iterations);
+	const ld duration = iterations * params::h;
+	StepController controller(params::adaptive_tolerance, params::h,
+			params::max_time_step);
+	Model model = params::model();
+	cluster.set_error_estimate(true);
+	for (ld t = 0; duration - t > 0.5 * params::h; ) {
+		model.h = min(controller.get_h(), duration - t);
+		model.sqrt_h = sqrt(model.h);
+		cluster.set_model(model);
+		evolve(cluster);
+		t += model.h;
+		controller.update(model.h, cluster.get_step_error());
+		progress.move_to((int) (t / params::h) - 1, cluster);
+	}
+	progress.finish();
+	cluster.set_error_estimate(false);
+	cluster.set_model(params::model());
+	controller.report(stdout, "relaxation");
+}
 
-	Point f0 = f(v0, u_A);
-	Point g_E0 = g_E();
-	Point g_v0 = g_v(v0);
-	Point g_phi0 = g_phi(v0);
+/**
+ * seed_cluster - initial state of @cluster: parallel engine takes
+ * it from counter-based noise, so it depends on the point only,
+ * not on what was simulated (or taken from cache) before
+ */
+void seed_cluster(Cluster &cluster)
+{
+	if (params::parallel_engine)
+		cluster.seed_from_noise(params::speed_lowest,
+				params::speed_highest);
+	else
+		cluster.seed_uniformly(params::speed_lowest,
+				params::speed_highest);
+}
 
-	Point v1 = v0 + f0 * params::h + params::sqrt_h *
-  	  (g_E0 * xi_E + g_v0 * xi_v + g_phi0 * xi_phi);
+/**
+ * reference_measurement - order parameter at current D_phi by Heun
+ * scheme with @reference_time_step over the same time as main runs
+ */
+ld reference_measurement(Cluster &cluster, Progress &progress,
+		uint64_t seed)
+{
+	Model model = params::model();
+	model.scheme = scheme_heun;
+	model.h = params::reference_time_step;
+	model.sqrt_h = sqrt(model.h);
+	ld scale = params::h / model.h;
+	cluster.reinit(params::N, params::L_size,
+			params::local_visibility, params::epsilon);
+	cluster.set_model(model);
+	cluster.set_noise_seed(seed);
+	seed_cluster(cluster);
+	run_phase(cluster, progress, "reference relaxation",
+		(int) (params::relaxation_iterations * scale + 0.5));
+	cluster.start_speed_measurement();
+	run_phase(cluster, progress, "reference observation",
+		(int) (params::iterations * scale + 0.5));
+	return cluster.get_measurement();
+}
 
-  	Point f1 = f(v1, u_A);
-  	Point g_E1 = g_E();
-  	Point g_v1 = g_v(v1);
-  	Point g_phi1 = g_phi(v1);
+void generate_output_name(char *name, const char *prefix, const char *ext)
+{
+	char timestamp_buf[64];
+	time_t t1 = time(NULL);
+	struct tm *t2 = localtime(&t1);
+	strftime(timestamp_buf, sizeof(timestamp_buf), "%b%d-%H%M", t2);
+	sprintf(name, "%s-%s.%s", prefix, timestamp_buf, ext);
+}
 
-  	Point f_avg = (f0 + f1) * 0.5;
-  	Point g_E_avg = (g_E0 + g_E1) * 0.5;
-  	Point g_v_avg = (g_v0 + g_v1) * 0.5;
-  	Point g_phi_avg = (g_phi0 + g_phi1) * 0.5;
+/* seconds since @start */
+double seconds_since(const chrono::steady_clock::time_point &start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() -
+			start).count();
+}
 
-  	Point v2 = v0 + f_avg * params::h +
-  	  (g_E_avg * xi_E + g_v_avg * xi_v +
-  	   g_phi_avg * xi_phi) * params::sqrt_h;
+/**
+ * benchmark_tuning - seconds per particle-step of parallel engine
+ * with @tuning on the configured system reduced to 20000 particles
+ * at the same density (if it keeps several epsilon in the box)
+ */
+double benchmark_tuning(const TuningParams &tuning)
+{
+	int N = min(params::N, 20000);
+	ld L = params::L_size * sqrt((ld) N / params::N);
+	if (L < 8 * params::epsilon) {
+		N = params::N;
+		L = params::L_size;
+	}
+	const int warmup = 10;
+	const int steps = max(20, 2000 * 1000 / N);
+	Cluster cluster(N, L, true, params::epsilon, true);
+	cluster.set_threads(tuning.threads);
+	cluster.set_grid_resolution(tuning.cells_per_epsilon);
+	cluster.set_tile_cells(tuning.tile_cells);
+	cluster.set_reorder_interval(tuning.reorder_interval);
+	cluster.set_noise_buffer(params::noise_buffer);
+	cluster.set_fixed_positions(params::fixed_positions);
+	cluster.set_model(params::model());
+	cluster.set_noise_seed(params::seed);
+	/* not by ran3: it would shift initial states of the points */
+	cluster.seed_from_noise(params::speed_lowest, params::speed_highest);
+	for (int it = 0; it < warmup; ++it)
+		cluster.evolve_parallel();
+	auto start = chrono::steady_clock::now();
+	for (int it = 0; it < steps; ++it)
+		cluster.evolve_parallel();
+	return seconds_since(start) / ((double) N * steps);
+}
 
-  	return v2;
+/**
+ * tune - with @params::tuning_mode other than "off", performance
+ * parameters are replaced by those stored for this machine and
+ * class of system or, in "auto" mode, tuned and stored
+ */
+void tune()
+{
+	if (strcmp(params::tuning_mode, "off") == 0)
+		return;
+	Autotuner tuner(params::tuning_file);
+	const string key = Autotuner::key(params::N, params::L_size,
+			params::epsilon);
+	TuningParams tuning = { params::cells_per_epsilon, params::threads,
+		params::tile_cells, params::reorder_interval };
+	if (tuner.load(key, tuning)) {
+		printf("tuned parameters of '%s' are loaded\n", key.c_str());
+	} else if (strcmp(params::tuning_mode, "auto") == 0) {
+		printf("tuning for '%s'\n", key.c_str());
+		const int cores = max(1u, thread::hardware_concurrency());
+		tuning = tuner.tune(tuning, cores, benchmark_tuning, stdout);
+		if (!tuner.store(key, tuning))
+			printf("can't store tuned parameters to %s\n",
+				params::tuning_file);
+	} else {
+		printf("no tuned parameters for '%s'\n", key.c_str());
+		return;
+	}
+	params::cells_per_epsilon = tuning.cells_per_epsilon;
+	params::threads = tuning.threads;
+	params::tile_cells = tuning.tile_cells;
+	params::reorder_interval = tuning.reorder_interval;
+	params::tuned = true;
+	printf("cells_per_epsilon %d, threads %d, tile_cells %d, "
+		"reorder_interval %d\n", params::cells_per_epsilon,
+		params::threads, params::tile_cells, params::reorder_interval);
+	if (params::cache_directory[0] != '\0')
+		puts("results of tuned runs are cached apart from those "
+			"with configured parameters");
 }
 
-Point heun_position(Point r, Point v)
+/**
+ * run_sweep - every point of @params::sweep on its own Cluster;
+ * points are taken by @sweep_jobs workers in order of decreasing
+ * cost, so the longest ones don't end up last; the threads are
+ * split between jobs evenly, noise of a job depends only on seed
+ * and parameters of its point; points found in @cache are not run
+ */
+int run_sweep(ResultCache *cache)
 {
-	return r + v * params::rh;
+	const int steps = params::relaxation_iterations + params::iterations;
+	std::vector<SweepPoint> points = params::sweep->plan(params::L_size,
+			params::local_visibility, steps);
+	char output_name[128];
+	generate_output_name(output_name, "sweep", "log");
+	printf("log will be put to '%s'\n", output_name);
+	FILE *log = fopen(output_name, "wt");
+	if (log == NULL)
+		err(EXIT_FAILURE, "can't open file to write\n");
+	fprintf(log, "# point\tN\tepsilon\tmu\tD_E\tD_phi\tavg.speed\n");
+	std::mutex output;
+	auto report = [&] (const SweepPoint &point, ld avg_speed,
+			const char *note) {
+		std::lock_guard<std::mutex> lock(output);
+		printf("point #%d: N = %d, epsilon = %lf, mu = %lf, D_E = %lf, "
+			"D_phi = %lf, avg.speed = %lf%s\n", point.index, point.N,
+			point.epsilon, point.mu, point.D_E, point.D_phi, avg_speed,
+			note);
+		fflush(stdout);
+		fprintf(log, "%d\t%d\t%lf\t%lf\t%lf\t%lf\t%lf\n", point.index,
+			point.N, point.epsilon, point.mu, point.D_E, point.D_phi,
+			avg_speed);
+		fflush(log);
+	};
+	std::vector<SweepPoint> pending;
+	std::vector<CacheKey> keys;
+	for (size_t i = 0; i < points.size(); ++i) {
+		CacheKey key = params::point_key(points[i]);
+		std::vector<ld> cached;
+		key.add("seed", params::seed);
+		if (cache != NULL && cache->lookup(key, cached)) {
+			report(points[i], cached[0], " (cached)");
+			continue;
+		}
+		pending.push_back(points[i]);
+		keys.push_back(key);
+	}
+	if (pending.empty()) {
+		fclose(log);
+		return 0;
+	}
+	const int jobs = min(params::sweep_jobs, (int) pending.size());
+	const int threads = max(1, params::threads / jobs);
+	printf("%d points to run, %d jobs at once with %d threads each\n",
+		(int) pending.size(), jobs, threads);
+	ThreadPool pool(jobs);
+	pool.run((int) pending.size(), [&] (int task, int) {
+		const SweepPoint &point = pending[task];
+		const chrono::steady_clock::time_point start =
+			chrono::steady_clock::now();
+		Cluster cluster(point.N, params::L_size,
+				params::local_visibility, point.epsilon,
+				params::use_grid);
+		cluster.set_threads(threads);
+		cluster.set_reorder_interval(params::reorder_interval);
+		cluster.set_noise_buffer(params::noise_buffer);
+		cluster.set_fixed_positions(params::fixed_positions);
+		cluster.set_grid_resolution(params::cells_per_epsilon);
+		cluster.set_tile_cells(params::tile_cells);
+		cluster.set_model(params::model_of(point));
+		cluster.set_noise_seed(params::noise_seed(point));
+		cluster.seed_from_noise(params::speed_lowest,
+				params::speed_highest);
+		for (int it = 0; it < params::relaxation_iterations; ++it)
+			cluster.evolve_parallel();
+		cluster.start_speed_measurement();
+		for (int it = 0; it < params::iterations; ++it)
+			cluster.evolve_parallel();
+		ld avg_speed = cluster.get_measurement();
+		report(point, avg_speed, "");
+		if (cache != NULL) {
+			std::vector<ld> values;
+			values.push_back(avg_speed);
+			values.push_back(seconds_since(start));
+			std::lock_guard<std::mutex> lock(output);
+			cache->store(keys[task], values);
+		}
+	});
+	fclose(log);
+	return 0;
 }
 
-void generate_output_name(char *name)
+#ifdef WITH_MPI
+/**
+ * run_distributed - the same sweep over D_phi by Domain, particles
+ * are split between ranks of MPI_COMM_WORLD, rank 0 writes the log
+ */
+int run_distributed()
 {
-	char timestamp_buf[64];
-	time_t t1 = time(NULL);
-	struct tm *t2 = localtime(&t1);
-	strftime(timestamp_buf, sizeof(timestamp_buf), "%b%d-%H%M", t2);
-	sprintf(name, "cluster-%s.log", timestamp_buf);
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	FILE *udphi = NULL;
+	if (rank == 0) {
+		char output_name[128];
+		generate_output_name(output_name, "cluster", "log");
+		printf("log will be put to '%s'\n", output_name);
+		udphi = fopen(output_name, "wt");
+		if (udphi == NULL)
+			err(EXIT_FAILURE, "can't open file to write\n");
+	}
+	bool logarithmic = params::D_phi_log_step > 0;
+	int point = 0;
+	for (ld d = params::D_phi_start; d <= params::D_phi_end + 1e-7;
+			/* see end of loop */) {
+		params::set_D_phi(d);
+		Domain domain(MPI_COMM_WORLD, params::N, params::L_size,
+				params::epsilon);
+		domain.set_model(params::model());
+		domain.set_noise_seed(((uint64_t) params::seed << 32) + point++);
+		domain.seed_uniformly(params::speed_lowest, params::speed_highest);
+		for (int it = 0; it < params::relaxation_iterations; ++it)
+			domain.evolve();
+		domain.start_speed_measurement();
+		for (int it = 0; it < params::iterations; ++it)
+			domain.evolve();
+		ld avg_speed = domain.get_measurement();
+		printf("D_phi = %lf, avg.speed = %lf\n", params::D_phi, avg_speed);
+		fflush(stdout);
+		if (udphi != NULL)
+			fprintf(udphi, "%lf\t%lf\n", params::D_phi, avg_speed);
+
+		if (logarithmic) {
+			d *= params::D_phi_log_step;
+		} else {
+			d += params::D_phi_step;
+		}
+	}
+	if (udphi != NULL)
+		fclose(udphi);
+	return 0;
 }
+#endif
 
 int main(int argc, char const *argv[])
 {
+#ifdef WITH_MPI
+	MPI_Init(NULL, NULL);
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	/* only rank 0 talks */
+	if (rank != 0 && freopen("/dev/null", "w", stdout) == NULL)
+		err(EXIT_FAILURE, "can't silence rank %d\n", rank);
+#endif
 	if (argc > 1) {
 		if (params::load_params(argv[1]) != 0) {
 			printf("problems occur while loading params "
@@ -229,50 +1061,165 @@ int main(int argc, char const *argv[])
 			return -1;
 		}
 	}
-	ProgressBar progress;
+#ifdef WITH_MPI
+	if (params::distributed_engine) {
+		int result = run_distributed();
+		MPI_Finalize();
+		return result;
+	}
+#endif
+	tune();
+	ResultCache *cache = NULL;
+	if (params::cache_directory[0] != '\0')
+		cache = new ResultCache(params::cache_directory,
+				params::cache_version);
+	if (params::sweep != NULL) {
+		int result = run_sweep(cache);
+		delete params::sweep;
+		delete cache;
+#ifdef WITH_MPI
+		MPI_Finalize();
+#endif
+		return result;
+	}
+	FILE *progress_file = NULL;
+	ProgressReporter *reporter = NULL;
+	if (strcmp(params::progress_output, "stderr") == 0) {
+		progress_file = stderr;
+	} else if (strcmp(params::progress_output, "stdout") == 0) {
+		progress_file = stdout;
+	} else if (params::progress_output[0] != '\0') {
+		progress_file = fopen(params::progress_output, "at");
+		if (progress_file == NULL)
+			err(EXIT_FAILURE, "can't open %s to write\n",
+				params::progress_output);
+	}
+	if (progress_file != NULL)
+		reporter = new ProgressReporter(progress_file,
+				params::progress_interval);
+	Progress progress(reporter);
 	Cluster cluster(params::N, params::L_size,
 			params::local_visibility, params::epsilon,
 			params::use_grid);
+	cluster.set_threads(params::threads);
+	if (params::local_visibility)
+		cluster.use_mesh(params::mesh_cells);
+	cluster.set_reorder_interval(params::reorder_interval);
+	cluster.set_noise_buffer(params::noise_buffer);
+	cluster.set_fixed_positions(params::fixed_positions);
+	cluster.set_grid_resolution(params::cells_per_epsilon);
+	cluster.set_tile_cells(params::tile_cells);
+	if (strcmp(params::pinning, "none") != 0) {
+		std::vector<int> cpus;
+		Topology::Instance().placement(params::pinning, params::threads,
+				cpus);
+		if (!cluster.set_placement(cpus, params::huge_pages))
+			errx(EXIT_FAILURE, "can't pin %d threads %s to CPUs of "
+				"the process", params::threads, params::pinning);
+	}
 	char output_name[128];
-	generate_output_name(output_name);
+	generate_output_name(output_name, "cluster", "log");
 	printf("log will be put to '%s'\n", output_name);
 	FILE *udphi = fopen(output_name, "wt");
 	if (udphi == NULL) {
 		err(EXIT_FAILURE, "can't open file to write\n");
 	}
-	bool logarithmic = params::D_phi_log_step > 0;
-	for (ld d = params::D_phi_start; d <= params::D_phi_end + 1e-7;
-			/* see end of loop */) {
-		params::set_D_phi(d);
+#ifdef PROFILE
+	char profile_name[128];
+	generate_output_name(profile_name, "profile", "json");
+	printf("profile will be put to '%s'\n", profile_name);
+	FILE *profile = fopen(profile_name, "wt");
+	if (profile == NULL) {
+		err(EXIT_FAILURE, "can't open file to write\n");
+	}
+	Profiler::Instance().set_peak_bandwidth(params::peak_bandwidth);
+#endif
+	TransitionSearch search(params::D_phi_values(),
+			params::D_phi_log_step > 0, params::D_phi_resolution,
+			params::D_phi_max_points);
+	ld D_phi;
+	while (search.next(D_phi)) {
+		params::set_D_phi(D_phi);
+		CacheKey key = params::point_key(params::base_point());
+		uint64_t seed = params::noise_seed(params::base_point());
+		key.add("seed", params::seed);
+		std::vector<ld> values;
+		if (cache != NULL && cache->lookup(key, values)) {
+			printf("D_phi = %lf, avg.speed = %lf (cached)\n",
+				params::D_phi, values[0]);
+			if (values.size() > 2)
+				fprintf(udphi, "%lf\t%lf\t%lf\n", params::D_phi,
+					values[0], values[2]);
+			else
+				fprintf(udphi, "%lf\t%lf\n", params::D_phi, values[0]);
+			search.record(params::D_phi, values[0]);
+			continue;
+		}
+		const chrono::steady_clock::time_point start =
+			chrono::steady_clock::now();
 		cluster.reinit(params::N, params::L_size,
 				params::local_visibility, params::epsilon);
-		cluster.seed_uniformly(params::speed_lowest, params::speed_highest);
-		printf("relaxation");
-		progress.start(params::relaxation_iterations);
-		for (int it = 0; it < params::relaxation_iterations; ++it) {
-			cluster.evolve(heun_speed, heun_position);
-			progress.check_and_move(it);
-		}
-		progress.finish_successfully();
-		printf("observation");
+		cluster.set_model(params::model());
+		cluster.set_noise_seed(seed);
+		seed_cluster(cluster);
+#ifdef PROFILE
+		Profiler::Instance().reset();
+#endif
+		relax(cluster, progress);
 		cluster.start_speed_measurement();
-		progress.start(params::iterations);
-		for (int it = 0; it < params::iterations; ++it) {
-			cluster.evolve(heun_speed, heun_position);
-			progress.check_and_move(it);
-		}
-		progress.finish_successfully();
+		run_phase(cluster, progress, "observation", params::iterations);
 		ld avg_speed = cluster.get_measurement();
+		search.record(params::D_phi, avg_speed);
+		values.assign(1, avg_speed);
 		printf("D_phi = %lf, avg.speed = %lf\n", params::D_phi, avg_speed);
-		fflush(stdout);
-		fprintf(udphi, "%lf\t%lf\n", params::D_phi, avg_speed);
-
-		if (logarithmic) {
-			d *= params::D_phi_log_step;
+		if (params::local_visibility && params::mesh_cells > 0)
+			cluster.report_mesh_error(stdout, 256);
+		if (params::local_visibility && params::use_grid)
+			printf("particles changing cell per step: %.3lf%%\n",
+				100 * cluster.get_crosser_fraction());
+		if (!params::local_order_radii.empty())
+			cluster.report_local_order(stdout, params::local_order_radii);
+		if (params::parallel_engine && params::noise_buffer > 0)
+			printf("steps waiting for noise: %.3lf%%\n",
+				100 * cluster.get_noise_underrun_fraction());
+		if (params::reference_time_step > 0) {
+			ld reference = reference_measurement(cluster, progress,
+					seed);
+			printf("reference (Heun, h = %lf): avg.speed = %lf, "
+				"difference = %+lf\n", params::reference_time_step,
+				reference, avg_speed - reference);
+			fprintf(udphi, "%lf\t%lf\t%lf\n", params::D_phi, avg_speed,
+				reference);
+			values.push_back(seconds_since(start));
+			values.push_back(reference);
 		} else {
-			d += params::D_phi_step;
+			fprintf(udphi, "%lf\t%lf\n", params::D_phi, avg_speed);
+			values.push_back(seconds_since(start));
 		}
+		if (cache != NULL)
+			cache->store(key, values);
+		fflush(stdout);
+#ifdef PROFILE
+		Profiler::Instance().print_summary(stdout);
+		Profiler::Instance().dump_json(profile, params::D_phi);
+#endif
 	}
+	if (params::D_phi_resolution > 0)
+		search.report(stdout);
+	if (cache != NULL)
+		printf("cached points: %d of %d\n", cache->get_hits(),
+			search.get_measured());
 	fclose(udphi);
+	delete cache;
+	delete reporter;
+	if (progress_file != NULL && progress_file != stderr &&
+			progress_file != stdout)
+		fclose(progress_file);
+#ifdef PROFILE
+	fclose(profile);
+#endif
+#ifdef WITH_MPI
+	MPI_Finalize();
+#endif
 	return 0;
 }
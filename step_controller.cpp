@@ -0,0 +1,45 @@
+#include <cmath>
+#include <algorithm>
+#include "step_controller.h"
+
+StepController::StepController(ld tolerance, ld h_min, ld h_max) :
+	tolerance(tolerance), h_min(h_min), h_max(std::max(h_min, h_max))
+{
+	start(h_min);
+}
+
+void StepController::start(ld h_arg)
+{
+	h = std::min(h_max, std::max(h_min, h_arg));
+	steps = 0;
+	time = 0;
+	smallest = h_max;
+	largest = 0;
+}
+
+void StepController::update(ld h_used, ld error)
+{
+	++steps;
+	time += h_used;
+	smallest = std::min(smallest, h_used);
+	largest = std::max(largest, h_used);
+
+	/**
+	 * error of the embedded pair is O(h) in noise terms and
+	 * O(h^2) in drift ones, exponent 1/2 is safe for both;
+	 * growth and shrink per step are limited
+	 */
+	ld factor = 2;
+	if (error > 0)
+		factor = std::min(ld(2), std::max(ld(0.2),
+			0.9 * sqrt(tolerance / error)));
+	h = std::min(h_max, std::max(h_min, h * factor));
+}
+
+void StepController::report(FILE *out, const char *phase) const
+{
+	if (steps == 0)
+		return;
+	fprintf(out, "%s: %d adaptive steps, h min/mean/max = "
+		"%lf/%lf/%lf\n", phase, steps, smallest, time / steps, largest);
+}
@@ -0,0 +1,81 @@
+#include <cmath>
+#include <algorithm>
+#include "sweep.h"
+
+bool Sweep::set(SweepPoint &point, const std::string &name, ld value)
+{
+	if (name == "number_of_particles")
+		point.N = (int) value;
+	else if (name == "epsilon")
+		point.epsilon = value;
+	else if (name == "mu")
+		point.mu = value;
+	else if (name == "passive_noise")
+		point.D_E = value;
+	else if (name == "angular_noise")
+		point.D_phi = value;
+	else
+		return false;
+	return true;
+}
+
+bool Sweep::add_axis(const char *name, const std::vector<ld> &values)
+{
+	SweepPoint probe = base;
+	if (!set(probe, name, 0))
+		return false;
+	axes.push_back(std::make_pair(std::string(name), values));
+	return true;
+}
+
+bool Sweep::has_axis(const char *name) const
+{
+	for (size_t i = 0; i < axes.size(); ++i)
+		if (axes[i].first == name)
+			return true;
+	return false;
+}
+
+bool Sweep::add_point(const std::vector<std::pair<std::string, ld> > &values)
+{
+	SweepPoint point = base;
+	for (size_t i = 0; i < values.size(); ++i)
+		if (!set(point, values[i].first, values[i].second))
+			return false;
+	points.push_back(point);
+	return true;
+}
+
+std::vector<SweepPoint> Sweep::plan(ld L, bool local_visibility,
+	int steps) const
+{
+	std::vector<SweepPoint> result = points;
+	if (result.empty()) {
+		/* product: the last axis changes fastest */
+		result.push_back(base);
+		for (size_t a = 0; a < axes.size(); ++a) {
+			std::vector<SweepPoint> next;
+			for (size_t i = 0; i < result.size(); ++i) {
+				for (size_t k = 0; k < axes[a].second.size(); ++k) {
+					SweepPoint point = result[i];
+					set(point, axes[a].first, axes[a].second[k]);
+					next.push_back(point);
+				}
+			}
+			result.swap(next);
+		}
+	}
+	const ld pi = acos(-1.0);
+	for (size_t i = 0; i < result.size(); ++i) {
+		SweepPoint &point = result[i];
+		point.index = (int) i;
+		ld neighbours = local_visibility ?
+			point.N * pi * point.epsilon * point.epsilon / (L * L) : 0;
+		point.cost = (ld) point.N * steps * (1 + neighbours);
+	}
+	std::stable_sort(result.begin(), result.end(),
+		[] (const SweepPoint &a, const SweepPoint &b) {
+			return a.cost > b.cost;
+		});
+	return result;
+}
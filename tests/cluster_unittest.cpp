@@ -0,0 +1,42 @@
+#include <cmath>
+
+#include "cluster.h"
+#include "gtest/gtest.h"
+
+/* order parameter of @steps parallel steps, reordered every @reorder */
+static ld order_parameter(bool local, int reorder, int steps)
+{
+	Model model;
+	model.mu = 1;
+	model.h = 0.005;
+	model.sqrt_h = sqrt(model.h);
+	model.sqrt2_D_E = 0.1;
+	model.sqrt2_D_v = 0;
+	model.sqrt2_D_phi = 0.5;
+	model.scheme = scheme_heun;
+	const int N = 4000;
+	Cluster cluster(N, 2, local, 0.1, local);
+	cluster.set_model(model);
+	cluster.set_threads(3);
+	cluster.set_reorder_interval(reorder);
+	cluster.set_noise_seed(3);
+	cluster.seed_from_noise(-1, 1);
+	cluster.start_speed_measurement();
+	for (int step = 0; step < steps; ++step)
+		cluster.evolve_parallel();
+	return cluster.get_measurement();
+}
+
+/**
+ * noise follows particles through reordering, but sums in cells
+ * and tiles are taken in the new order of storage, so results
+ * agree up to rounding, not bitwise
+ */
+TEST(ClusterTest, ReorderingChangesRoundingOnly) {
+	for (int local = 0; local < 2; ++local) {
+		ld plain = order_parameter(local, 0, 60);
+		ld reordered = order_parameter(local, 7, 60);
+		ASSERT_GT(plain, 0);
+		ASSERT_NEAR(plain, reordered, 1e-12 * plain) << "local " << local;
+	}
+}
@@ -0,0 +1,98 @@
+#include <vector>
+#include <algorithm>
+#include <mpi.h>
+
+#include "domain.h"
+#include "gtest/gtest.h"
+
+/* run by mpirun with several ranks, see `make mpi_check` */
+class DomainTest : public ::testing::Test {
+protected:
+	virtual void SetUp() {
+		N = 3600;
+		L = 6;
+		epsilon = 0.2;
+		model.mu = 1;
+		model.h = 0.005;
+		model.sqrt_h = sqrt(model.h);
+		model.sqrt2_D_E = sqrt(2 * 0.01);
+		model.sqrt2_D_v = 0;
+		model.sqrt2_D_phi = sqrt(2 * 0.1);
+	}
+
+	void prepare(Domain &domain) {
+		domain.set_model(model);
+		domain.set_noise_seed(7);
+		domain.seed_uniformly(-1, 1);
+	}
+
+	/* distance in periodic box: rounding may wrap one of positions */
+	ld distance(const Point &a, const Point &b) {
+		ld best = (a - b).length();
+		for (int dx = -1; dx <= 1; ++dx)
+			for (int dy = -1; dy <= 1; ++dy)
+				best = std::min(best,
+					(a - b + Point(dx * L, dy * L)).length());
+		return best;
+	}
+
+	int N;
+	ld L;
+	ld epsilon;
+	Model model;
+};
+
+/* Particles are neither lost nor duplicated while migrating */
+TEST_F(DomainTest, ParticlesAreConserved) {
+	Domain domain(MPI_COMM_WORLD, N, L, epsilon);
+	prepare(domain);
+	model.h = 0.05;
+	domain.set_model(model);
+	for (int it = 0; it < 100; ++it)
+		domain.evolve();
+	int owned = domain.get_owned(), total = 0;
+	MPI_Allreduce(&owned, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	ASSERT_EQ(N, total);
+
+	std::vector<Point> r, v;
+	domain.gather(r, v);
+	if (domain.get_rank() == 0) {
+		for (int i = 0; i < N; ++i)
+			ASSERT_GT(v[i].length(), 0) << "particle#" << i << " is lost";
+	}
+}
+
+/* Decomposed box evolves as the whole one on a single rank */
+TEST_F(DomainTest, SameAsSingleRank) {
+	Domain domain(MPI_COMM_WORLD, N, L, epsilon);
+	Domain whole(MPI_COMM_SELF, N, L, epsilon);
+	prepare(domain);
+	prepare(whole);
+	domain.start_speed_measurement();
+	whole.start_speed_measurement();
+	for (int it = 0; it < 40; ++it) {
+		domain.evolve();
+		whole.evolve();
+	}
+	ASSERT_NEAR(whole.get_measurement(), domain.get_measurement(), 1e-9);
+
+	std::vector<Point> r, v, r_whole, v_whole;
+	domain.gather(r, v);
+	whole.gather(r_whole, v_whole);
+	if (domain.get_rank() == 0) {
+		for (int i = 0; i < N; ++i) {
+			ASSERT_NEAR(0, distance(r[i], r_whole[i]), 1e-9)
+				<< "position of particle#" << i;
+			ASSERT_NEAR(0, (v[i] - v_whole[i]).length(), 1e-9)
+				<< "velocity of particle#" << i;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	MPI_Init(&argc, &argv);
+	::testing::InitGoogleTest(&argc, argv);
+	int result = RUN_ALL_TESTS();
+	MPI_Finalize();
+	return result;
+}
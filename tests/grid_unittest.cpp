@@ -2,6 +2,7 @@
 #include <algorithm>
 
 #include "grid.h"
+#include "thread_pool.h"
 #include "gtest/gtest.h"
 
 class GridTest : public ::testing::Test {
@@ -73,6 +74,28 @@ protected:
 		}
 	}
 
+	std::vector<Point> nextPositions() {
+		std::vector<Point> positions;
+		for (size_t i = 0; i < particles.size(); ++i) {
+			Particle *p = particles[i];
+			Point next_pos = velocities[i] + Point(p->get_x(), p->get_y());
+			next_pos.normalize_to_rect(0, side, 0, side);
+			positions.push_back(next_pos);
+		}
+		return positions;
+	}
+
+	/* the same as @evolve, but via Grid::update_positions */
+	int evolveIncrementally() {
+		return grid->update_positions(nextPositions());
+	}
+
+	/* the same as @evolve, but via Grid::rebuild */
+	int evolveInParallel(ThreadPool &pool) {
+		gridPrepared = true;
+		return grid->rebuild(nextPositions(), &velocities, pool);
+	}
+
 	bool speedEqual(const Point &speed, double num) {
 		return fabs(speed.length() - num) < EPS;
 	}
@@ -372,3 +395,144 @@ TEST_F(GridTest, LargeDynamicRandom) {
 		evolve();
 	}
 }
+
+/* Incremental update of all particles gives the same disc speeds as naive approach */
+TEST_F(GridTest, IncrementalUpdate) {
+	srand(43);
+	int amount = 300;
+
+	for (int i = 0; i < amount; ++i) {
+		addParticle(rnd_xy(), rnd_xy(), 0.01 * rnd_v(), -0.02 * rnd_v());
+	}
+
+	int total_crossers = 0;
+	for (int it = 0; it < 30; ++it) {
+		for (int i = 0; i < amount; ++i) {
+			Point s1 = getDiscSpeedNaively(i, 1.5);
+			Point s2 = getDiscSpeed(i, 1.5);
+			ASSERT_TRUE(speedEqual(s1 - s2, 0)) << "expected equality " <<
+				" at it = " << it << ", i = " << i;
+		}
+		int crossers = evolveIncrementally();
+		ASSERT_LE(crossers, amount);
+		total_crossers += crossers;
+	}
+	ASSERT_GT(total_crossers, 0) << "expected some particles to change cells";
+}
+
+/* Particles condensed into a narrow band, so most of cells are empty */
+TEST_F(GridTest, CondensedBand) {
+	srand(44);
+	int amount = 400;
+
+	for (int i = 0; i < amount; ++i) {
+		double x = side * (rand() / (RAND_MAX + 1.0));
+		double y = side - 0.3 + 0.6 * (rand() / (RAND_MAX + 1.0));
+		if (y >= side)
+			y -= side;
+		addParticle(x, y, rnd_v(), -rnd_v());
+	}
+
+	for (int i = 0; i < amount; ++i) {
+		Point s1 = getDiscSpeedNaively(i, 0.45);
+		Point s2 = getDiscSpeed(i, 0.45);
+		ASSERT_TRUE(speedEqual(s1 - s2, 0)) << "expected equality for particle#" << i;
+	}
+}
+
+/* Grid built from scratch on several threads gives the same disc speeds as naive approach */
+TEST_F(GridTest, ParallelRebuild) {
+	srand(45);
+	int amount = 500;
+	ThreadPool pool(4);
+
+	for (int i = 0; i < amount; ++i) {
+		addParticle(rnd_xy(), rnd_xy(), -0.01 * rnd_v(), 0.03 * rnd_v());
+	}
+
+	int total_crossers = 0;
+	for (int it = 0; it < 20; ++it) {
+		int crossers = evolveInParallel(pool);
+		ASSERT_LE(crossers, amount);
+		total_crossers += crossers;
+		for (int i = 0; i < amount; ++i) {
+			Point s1 = getDiscSpeedNaively(i, 1.5);
+			Point s2 = getDiscSpeed(i, 1.5);
+			ASSERT_TRUE(speedEqual(s1 - s2, 0)) << "expected equality " <<
+				" at it = " << it << ", i = " << i;
+		}
+	}
+	ASSERT_GT(total_crossers, 0) << "expected some particles to change cells";
+}
+
+/* All radii at once give the same as separate queries */
+TEST_F(GridTest, MultiRadiusQuery) {
+	srand(46);
+	int amount = 400;
+
+	for (int i = 0; i < amount; ++i) {
+		addParticle(side * rand() / (RAND_MAX + 1.0),
+			side * rand() / (RAND_MAX + 1.0), rnd_v(), -rnd_v());
+	}
+	grid->update_for_search(&velocities);
+	grid->update_cell_sums();
+	gridPrepared = true;
+
+	std::vector<double> radii = {0.05, 0.4, 1.5, 3.3, 4.9};
+	const int k = (int) radii.size();
+	Point sums[Grid::max_radii];
+	int counts[Grid::max_radii];
+	for (int i = 0; i < amount; ++i) {
+		grid->get_disc_speeds(*particles[i], radii, sums, counts);
+		for (int j = 0; j < k; ++j) {
+			Point naive = getDiscSpeedNaively(i, radii[j]);
+			ASSERT_EQ(found_particles, counts[j] - 1) << "particle#" << i
+				<< ", radius " << radii[j];
+			if (found_particles == 0)
+				continue;
+			Point s = (sums[j] - velocities[i]) / (counts[j] - 1);
+			ASSERT_TRUE(speedEqual(s - naive, 0)) << "particle#" << i
+				<< ", radius " << radii[j];
+		}
+	}
+}
+
+/* Minimum image distances of fixed-point positions give the same discs */
+TEST_F(GridTest, FixedPositions) {
+	srand(47);
+	int amount = 400;
+	FixedFrame frame(side);
+	std::vector<FixedPoint> fixed;
+
+	for (int i = 0; i < amount; ++i) {
+		Point p(side * rand() / (RAND_MAX + 1.0) - side / 2,
+			side * rand() / (RAND_MAX + 1.0) + side / 2);
+		/* around the square by steps shorter than side / 2 */
+		FixedPoint f = frame.to_fixed(p);
+		for (int step = 0; step < 4; ++step)
+			f = frame.advance(f, Point(side / 4, 0));
+		fixed.push_back(f);
+		Point wrapped = frame.to_point(fixed.back());
+		p.normalize_to_rect(0, side, 0, side);
+		ASSERT_NEAR(0, (frame.difference(fixed.back(), frame.to_fixed(p))
+			).length(), 1e-6) << "particle#" << i;
+		addParticle(0, 0, rnd_v(), -rnd_v());
+		grid->move(particles[i], wrapped);
+		ASSERT_EQ(grid->cell_index(wrapped), grid->cell_index(fixed[i]));
+	}
+	grid->update_for_search(&velocities);
+	grid->update_cell_sums();
+
+	int found, fixed_found;
+	for (int i = 0; i < amount; ++i) {
+		for (double radius = 0.3; radius < 4.5; radius += 1.3) {
+			grid->set_fixed_positions(NULL, frame);
+			Point s1 = grid->get_disc_speed(*particles[i], radius, found);
+			grid->set_fixed_positions(&fixed, frame);
+			Point s2 = grid->get_disc_speed(*particles[i], radius,
+				fixed_found);
+			ASSERT_EQ(found, fixed_found) << "particle#" << i;
+			ASSERT_TRUE(speedEqual(s1 - s2, 0)) << "particle#" << i;
+		}
+	}
+}
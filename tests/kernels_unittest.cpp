@@ -0,0 +1,58 @@
+#include <vector>
+#include <cstdlib>
+
+#include "kernels.h"
+#include "stream_gen.h"
+#include "grid.h"
+#include "gtest/gtest.h"
+
+/* Every variant the CPU supports gives the same noise as StreamGen */
+TEST(KernelsTest, NoiseOfAllVariants) {
+	StreamGen gen(12345);
+	const uint64_t key = gen.step_key(17);
+	const int first = 1000, count = 333;
+	std::vector<Noise> expected(count), xi(count);
+	for (int i = 0; i < count; ++i)
+		gen.noise(key, first + i, &expected[i]);
+	const isa_id detected = Kernels::detect();
+	for (int isa = 0; isa < isa_count; ++isa) {
+		if (!Kernels::supported((isa_id) isa))
+			continue;
+		Kernels::select((isa_id) isa);
+		Kernels::noise(key, first, count, xi.data());
+		for (int i = 0; i < count; ++i) {
+			ASSERT_EQ(expected[i].x, xi[i].x) << Kernels::name((isa_id) isa);
+			ASSERT_EQ(expected[i].y, xi[i].y) << Kernels::name((isa_id) isa);
+			ASSERT_EQ(expected[i].v, xi[i].v) << Kernels::name((isa_id) isa);
+			ASSERT_EQ(expected[i].phi, xi[i].phi)
+				<< Kernels::name((isa_id) isa);
+		}
+	}
+	Kernels::select(detected);
+}
+
+/* ... and the same cells as Grid::cell_index, including the borders */
+TEST(KernelsTest, CellIndicesOfAllVariants) {
+	srand(48);
+	const double side = 7.3;
+	Grid grid(side, side, 91, 91);
+	std::vector<Point> positions;
+	for (int i = 0; i < 1001; ++i)
+		positions.push_back(Point(side * rand() / RAND_MAX,
+			side * rand() / RAND_MAX));
+	positions.push_back(Point(side, 0));
+	positions.push_back(Point(-1e-9, side + 1e-9));
+	const int count = (int) positions.size();
+	std::vector<int> cells(count);
+	const isa_id detected = Kernels::detect();
+	for (int isa = 0; isa < isa_count; ++isa) {
+		if (!Kernels::supported((isa_id) isa))
+			continue;
+		Kernels::select((isa_id) isa);
+		grid.cell_indices(positions.data(), count, cells.data());
+		for (int i = 0; i < count; ++i)
+			ASSERT_EQ(grid.cell_index(positions[i]), cells[i])
+				<< Kernels::name((isa_id) isa) << ", position #" << i;
+	}
+	Kernels::select(detected);
+}
@@ -0,0 +1,57 @@
+#include <vector>
+
+#include "mesh.h"
+#include "grid.h"
+#include "gtest/gtest.h"
+
+/* Mesh::get_disc_speed of every particle against Grid::get_disc_speed */
+static void compare_with_grid(const std::vector<double> &x,
+	const std::vector<double> &y, const std::vector<Point> &velocities,
+	double side, int cells, double radius)
+{
+	std::vector<Point> positions;
+	std::vector<Particle> particles;
+	for (size_t i = 0; i < x.size(); ++i) {
+		positions.push_back(Point(x[i], y[i]));
+		particles.push_back(Particle(i, x[i], y[i]));
+	}
+	Mesh mesh(side, cells, radius);
+	mesh.deposit(positions, velocities);
+	Grid grid(side, side, 10, 10);
+	for (size_t i = 0; i < particles.size(); ++i)
+		grid.add(&particles[i]);
+	std::vector<Point> v = velocities;
+	grid.update_for_search(&v);
+	for (size_t i = 0; i < positions.size(); ++i) {
+		Point approx = mesh.get_disc_speed(positions[i], velocities[i]);
+		Point exact = grid.get_disc_speed(particles[i], radius);
+		ASSERT_LT((exact - approx).length(), 1e-12) << "particle " << i;
+	}
+}
+
+/* the particle itself is excluded exactly, for any reach of the kernel */
+TEST(MeshTest, LoneParticle) {
+	const double side = 10, radius = 1;
+	const int cells[] = { 8, 11, 30 };
+	for (int c = 0; c < 3; ++c)
+		compare_with_grid(std::vector<double>(1, 3.37),
+			std::vector<double>(1, 6.81),
+			std::vector<Point>(1, Point(0.6, -0.8)), side, cells[c],
+			radius);
+}
+
+/* a neighbour much closer than a cell is seen as it is */
+TEST(MeshTest, TwoCloseParticles) {
+	const double side = 10, radius = 1;
+	const int cells[] = { 8, 11, 30 };
+	std::vector<double> x, y;
+	std::vector<Point> velocities;
+	x.push_back(3.37);
+	y.push_back(6.81);
+	x.push_back(3.3705);
+	y.push_back(6.8098);
+	velocities.push_back(Point(0.6, -0.8));
+	velocities.push_back(Point(-1, 0.1));
+	for (int c = 0; c < 3; ++c)
+		compare_with_grid(x, y, velocities, side, cells[c], radius);
+}
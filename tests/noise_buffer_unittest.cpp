@@ -0,0 +1,53 @@
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+
+#include "noise_buffer.h"
+#include "thread_pool.h"
+#include "gtest/gtest.h"
+
+/* ring gives the same noise as StreamGen, step after step */
+TEST(NoiseBufferTest, SameNoiseAsStreamGen) {
+	StreamGen gen(77);
+	const int particles = 100;
+	NoiseBuffer buffer(3);
+	for (uint64_t step = 0; step < 10; ++step) {
+		const Noise *xi = buffer.acquire(gen, particles, step);
+		const uint64_t key = gen.step_key(step);
+		for (int i = 0; i < particles; ++i) {
+			Noise expected;
+			gen.noise(key, i, &expected);
+			ASSERT_EQ(expected.x, xi[i].x);
+			ASSERT_EQ(expected.phi, xi[i].phi);
+		}
+		buffer.release();
+	}
+}
+
+/**
+ * producer started by the pinned thread doesn't share its CPU,
+ * unless there is no other one
+ */
+TEST(NoiseBufferTest, ProducerLeavesPinnedCpu) {
+	cpu_set_t allowed;
+	ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(allowed),
+		&allowed));
+	int first = 0;
+	while (!CPU_ISSET(first, &allowed))
+		++first;
+	cpu_set_t expected = allowed;
+	CPU_CLR(first, &expected);
+	if (CPU_COUNT(&expected) == 0)
+		expected = allowed;
+
+	ThreadPool pool(1);
+	ASSERT_TRUE(pool.pin(std::vector<int>(1, first)));
+	NoiseBuffer buffer(2);
+	buffer.set_placement(&pool, false);
+	StreamGen gen(1);
+	buffer.acquire(gen, 16, 0);
+	cpu_set_t mask;
+	ASSERT_TRUE(buffer.get_producer_affinity(mask));
+	ASSERT_TRUE(CPU_EQUAL(&expected, &mask));
+	buffer.release();
+}
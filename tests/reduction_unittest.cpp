@@ -0,0 +1,52 @@
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "reduction.h"
+#include "gtest/gtest.h"
+
+/* 1 + 1e-16 * n is lost by naive summation, but not by compensated */
+TEST(KahanSumTest, SmallTermsAreNotLost) {
+	KahanSum sum;
+	sum.add(1.0);
+	for (int i = 0; i < 1000; ++i)
+		sum.add(1e-16);
+	ASSERT_NEAR(sum.value(), 1.0 + 1e-13, 1e-18);
+}
+
+TEST(KahanSumTest, MergeOfPartialSums) {
+	KahanSum a, b, whole;
+	for (int i = 0; i < 100; ++i) {
+		double x = 1.0 / (i + 1);
+		whole.add(x);
+		if (i < 50)
+			a.add(x);
+		else
+			b.add(x);
+	}
+	a.add(b);
+	ASSERT_NEAR(a.value(), whole.value(), 1e-15);
+}
+
+/* blocked_sum must give bitwise equal results for any number of threads */
+TEST(BlockedSumTest, IndependentOfThreads) {
+	srand(42);
+	int n = 10 * reduction_block + 17;
+	std::vector<Point> terms;
+	for (int i = 0; i < n; ++i)
+		terms.push_back(Point(rand() / (double) RAND_MAX - 0.5,
+			1e6 * (rand() / (double) RAND_MAX)));
+	auto term = [&] (int i) -> const Point & { return terms[i]; };
+
+	ThreadPool single(1);
+	std::vector<PointSum> partial;
+	Point expected = blocked_sum(single, n, partial, term).value();
+	for (int threads = 2; threads <= 8; threads *= 2) {
+		ThreadPool pool(threads);
+		for (int run = 0; run < 5; ++run) {
+			Point actual = blocked_sum(pool, n, partial, term).value();
+			ASSERT_EQ(0, memcmp(&expected, &actual, sizeof actual)) <<
+				"sums differ with " << threads << " threads";
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "result_cache.h"
+#include "gtest/gtest.h"
+
+class ResultCacheTest : public ::testing::Test {
+protected:
+	std::string directory;
+
+	virtual void SetUp()
+	{
+		char name[] = "/tmp/result_cache_XXXXXX";
+		ASSERT_TRUE(mkdtemp(name) != NULL);
+		directory = name;
+	}
+
+	virtual void TearDown()
+	{
+		std::string command = "rm -rf " + directory;
+		ASSERT_EQ(system(command.c_str()), 0);
+	}
+
+	static CacheKey key(ld D_phi)
+	{
+		CacheKey key;
+		key.add("N", 1000);
+		key.add("D_phi", D_phi);
+		return key;
+	}
+};
+
+TEST_F(ResultCacheTest, RoundTrip) {
+	ResultCache cache(directory.c_str(), "1");
+	std::vector<ld> stored, loaded;
+	stored.push_back(0.1);
+	stored.push_back(1.0 / 3);
+	ASSERT_FALSE(cache.lookup(key(0.05), loaded));
+	ASSERT_TRUE(cache.store(key(0.05), stored));
+	ASSERT_TRUE(cache.lookup(key(0.05), loaded));
+	ASSERT_EQ(loaded, stored);
+	ASSERT_FALSE(cache.lookup(key(0.06), loaded));
+	/* other version drops everything */
+	ResultCache next(directory.c_str(), "2");
+	ASSERT_FALSE(next.lookup(key(0.05), loaded));
+	ASSERT_EQ(cache.get_hits(), 1);
+	ASSERT_EQ(cache.get_misses(), 2);
+}
+
+/* file of the same hash but other key, as after a collision, is a miss */
+TEST_F(ResultCacheTest, CollisionIsMiss) {
+	ResultCache cache(directory.c_str(), "1");
+	CacheKey versioned = key(0.05);
+	versioned.add("version", "1");
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx",
+		(unsigned long long) versioned.hash());
+	FILE *out = fopen((directory + name).c_str(), "wt");
+	ASSERT_TRUE(out != NULL);
+	fprintf(out, "%s\n0.5\n", key(0.07).text().c_str());
+	fclose(out);
+	std::vector<ld> values;
+	ASSERT_FALSE(cache.lookup(key(0.05), values));
+	/* and a record without values */
+	out = fopen((directory + name).c_str(), "wt");
+	ASSERT_TRUE(out != NULL);
+	fprintf(out, "%s\n\n", versioned.text().c_str());
+	fclose(out);
+	ASSERT_FALSE(cache.lookup(key(0.05), values));
+	/* the same file with the right key is found */
+	out = fopen((directory + name).c_str(), "wt");
+	ASSERT_TRUE(out != NULL);
+	fprintf(out, "%s\n0.5\n", versioned.text().c_str());
+	fclose(out);
+	ASSERT_TRUE(cache.lookup(key(0.05), values));
+	ASSERT_EQ(values, std::vector<ld>(1, 0.5));
+}
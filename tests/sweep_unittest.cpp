@@ -0,0 +1,62 @@
+#include <cmath>
+#include <vector>
+
+#include "sweep.h"
+#include "gtest/gtest.h"
+
+static SweepPoint base_point()
+{
+	SweepPoint point;
+	point.N = 100;
+	point.epsilon = 0.1;
+	point.mu = 1;
+	point.D_E = 0.01;
+	point.D_phi = 0.05;
+	point.index = 0;
+	point.cost = 0;
+	return point;
+}
+
+/* equal costs keep the order of product, the last axis changes fastest */
+TEST(SweepTest, ProductOrder) {
+	Sweep sweep(base_point());
+	ASSERT_FALSE(sweep.add_axis("no_such_parameter", std::vector<ld>(1, 1)));
+	std::vector<ld> mu, D_phi;
+	mu.push_back(1);
+	mu.push_back(2);
+	D_phi.push_back(0.1);
+	D_phi.push_back(0.2);
+	D_phi.push_back(0.3);
+	ASSERT_TRUE(sweep.add_axis("mu", mu));
+	ASSERT_TRUE(sweep.add_axis("angular_noise", D_phi));
+	std::vector<SweepPoint> plan = sweep.plan(10, false, 50);
+	ASSERT_EQ(plan.size(), 6u);
+	for (int i = 0; i < 6; ++i) {
+		ASSERT_EQ(plan[i].index, i);
+		ASSERT_EQ(plan[i].mu, mu[i / 3]);
+		ASSERT_EQ(plan[i].D_phi, D_phi[i % 3]);
+		ASSERT_EQ(plan[i].N, 100);
+		ASSERT_EQ(plan[i].cost, 100 * 50);
+	}
+}
+
+/* the most expensive point goes first, index keeps order of definition */
+TEST(SweepTest, PlanByCost) {
+	Sweep sweep(base_point());
+	std::vector<ld> N;
+	N.push_back(100);
+	N.push_back(1000);
+	N.push_back(500);
+	ASSERT_TRUE(sweep.add_axis("number_of_particles", N));
+	const ld L = 10;
+	std::vector<SweepPoint> plan = sweep.plan(L, true, 50);
+	ASSERT_EQ(plan.size(), 3u);
+	const int order[] = { 1, 2, 0 };
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(plan[i].index, order[i]);
+		ASSERT_EQ(plan[i].N, (int) N[order[i]]);
+		ld neighbours = N[order[i]] * acos(-1.0) * 0.1 * 0.1 / (L * L);
+		ASSERT_NEAR(plan[i].cost, N[order[i]] * 50 * (1 + neighbours),
+			1e-9 * plan[i].cost);
+	}
+}
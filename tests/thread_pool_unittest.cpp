@@ -0,0 +1,57 @@
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+
+#include "thread_pool.h"
+#include "gtest/gtest.h"
+
+static std::vector<int> allowed_cpus()
+{
+	cpu_set_t set;
+	pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+	std::vector<int> cpus;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		if (CPU_ISSET(cpu, &set))
+			cpus.push_back(cpu);
+	return cpus;
+}
+
+/* pinned pool deals contiguous parts of tasks, the same in every run */
+TEST(ThreadPoolTest, PinnedPoolDealsTasksStatically) {
+	const int threads = 3, tasks = 10;
+	ThreadPool pool(threads);
+	ASSERT_TRUE(pool.pin(std::vector<int>(threads, sched_getcpu())));
+	ASSERT_TRUE(pool.is_pinned());
+	for (int run = 0; run < 5; ++run) {
+		std::vector<int> thread_of(tasks, -1);
+		pool.run(tasks, [&] (int task, int thread) {
+			thread_of[task] = thread;
+		});
+		for (int t = 0; t < threads; ++t)
+			for (int task = tasks * t / threads;
+					task < tasks * (t + 1) / threads; ++task)
+				ASSERT_EQ(t, thread_of[task]) << "task " << task;
+	}
+}
+
+/* the calling thread gets its affinity back with the pool's end */
+TEST(ThreadPoolTest, CallerAffinityIsRestored) {
+	const std::vector<int> before = allowed_cpus();
+	{
+		ThreadPool pool(2);
+		ASSERT_TRUE(pool.pin(std::vector<int>(2, before[0])));
+		ASSERT_EQ(std::vector<int>(1, before[0]), allowed_cpus());
+	}
+	ASSERT_EQ(before, allowed_cpus());
+}
+
+/* a CPU out of reach leaves the pool unpinned */
+TEST(ThreadPoolTest, FailedPinLeavesPoolAsItWas) {
+	const std::vector<int> before = allowed_cpus();
+	ThreadPool pool(2);
+	std::vector<int> cpus(2, before[0]);
+	cpus[1] = CPU_SETSIZE - 1;
+	ASSERT_FALSE(pool.pin(cpus));
+	ASSERT_FALSE(pool.is_pinned());
+	ASSERT_EQ(before, allowed_cpus());
+}
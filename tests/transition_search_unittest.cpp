@@ -0,0 +1,52 @@
+#include <cmath>
+#include <vector>
+
+#include "transition_search.h"
+#include "gtest/gtest.h"
+
+/* order parameter falls from 1 to 0 within 0.001 around 0.1234 */
+static ld sharp_transition(ld D_phi)
+{
+	return 0.5 * (1 - tanh((D_phi - 0.1234) / 0.0002));
+}
+
+/* 0.02 grid and bisection find it to 0.001 with 34 points, not 300 */
+TEST(TransitionSearchTest, FindsSharpTransition) {
+	std::vector<ld> coarse;
+	for (int i = 0; i <= 15; ++i)
+		coarse.push_back(0.02 * i);
+	TransitionSearch search(coarse, false, 0.001, 300);
+	std::vector<ld> measured;
+	ld D_phi;
+	while (search.next(D_phi)) {
+		search.record(D_phi, sharp_transition(D_phi));
+		measured.push_back(D_phi);
+	}
+	ASSERT_LE(search.get_measured(), 34);
+	ASSERT_EQ(search.get_measured(), (int) measured.size());
+	ld below = 0, above = 1;
+	for (size_t i = 0; i < measured.size(); ++i) {
+		if (measured[i] < 0.1234)
+			below = std::max(below, measured[i]);
+		else
+			above = std::min(above, measured[i]);
+	}
+	ASSERT_LE(above - below, 0.001);
+}
+
+TEST(TransitionSearchTest, GeometricBisectionAndLimit) {
+	std::vector<ld> coarse;
+	coarse.push_back(0.01);
+	coarse.push_back(1);
+	TransitionSearch search(coarse, true, 1e-6, 3);
+	ld D_phi;
+	ASSERT_TRUE(search.next(D_phi));
+	search.record(D_phi, 1);
+	ASSERT_TRUE(search.next(D_phi));
+	search.record(D_phi, 0);
+	ASSERT_TRUE(search.next(D_phi));
+	ASSERT_NEAR(D_phi, 0.1, 1e-12);
+	search.record(D_phi, 0.5);
+	/* @max_points are measured */
+	ASSERT_FALSE(search.next(D_phi));
+}
@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads_arg) :
+	threads(threads_arg < 1 ? 1 : threads_arg), pinned(false),
+	job(nullptr), tasks(0), next_task(0), busy(0),
+	generation(0), stopping(false)
+{
+	for (int i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	if (pinned)
+		pthread_setaffinity_np(caller, sizeof(caller_mask), &caller_mask);
+}
+
+int ThreadPool::size() const
+{
+	return threads;
+}
+
+static bool bind(pthread_t thread, int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool ThreadPool::pin(const std::vector<int> &cpus)
+{
+	if (pinned || (int) cpus.size() < threads)
+		return false;
+	caller = pthread_self();
+	if (pthread_getaffinity_np(caller, sizeof(caller_mask),
+			&caller_mask) != 0)
+		return false;
+	bool bound = bind(caller, cpus[0]);
+	for (size_t i = 0; bound && i < workers.size(); ++i)
+		bound = bind(workers[i].native_handle(), cpus[i + 1]);
+	if (!bound) {
+		pthread_setaffinity_np(caller, sizeof(caller_mask), &caller_mask);
+		for (size_t i = 0; i < workers.size(); ++i)
+			pthread_setaffinity_np(workers[i].native_handle(),
+				sizeof(caller_mask), &caller_mask);
+		return false;
+	}
+	pinned_cpus.assign(cpus.begin(), cpus.begin() + threads);
+	pinned = true;
+	return true;
+}
+
+bool ThreadPool::spare_cpus(cpu_set_t &mask) const
+{
+	if (!pinned)
+		return false;
+	mask = caller_mask;
+	for (size_t i = 0; i < pinned_cpus.size(); ++i)
+		CPU_CLR(pinned_cpus[i], &mask);
+	if (CPU_COUNT(&mask) == 0)
+		mask = caller_mask;
+	return true;
+}
+
+void ThreadPool::drain(int thread)
+{
+	if (pinned) {
+		int end = (long long) tasks * (thread + 1) / threads;
+		for (int task = (long long) tasks * thread / threads;
+				task < end; ++task)
+			(*job)(task, thread);
+		return;
+	}
+	for (int task = next_task++; task < tasks; task = next_task++)
+		(*job)(task, thread);
+}
+
+void ThreadPool::run(int tasks_arg, const job_t &job_arg)
+{
+	if (workers.empty() || tasks_arg <= 1) {
+		for (int task = 0; task < tasks_arg; ++task)
+			job_arg(task, 0);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &job_arg;
+		tasks = tasks_arg;
+		next_task = 0;
+		busy = (int) workers.size();
+		++generation;
+	}
+	wake.notify_all();
+	drain(0);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (busy > 0)
+		done.wait(lock);
+	job = nullptr;
+}
+
+void ThreadPool::worker_loop(int thread)
+{
+	unsigned long seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping && generation == seen)
+				wake.wait(lock);
+			if (stopping)
+				return;
+			seen = generation;
+		}
+		drain(thread);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
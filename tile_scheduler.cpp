@@ -0,0 +1,68 @@
+#include <algorithm>
+#include "tile_scheduler.h"
+
+TileScheduler::TileScheduler() :
+	queues(nullptr), workers(0), steals(0)
+{
+}
+
+TileScheduler::~TileScheduler()
+{
+	delete[] queues;
+}
+
+void TileScheduler::plan(const std::vector<double> &costs, int workers_arg)
+{
+	if (workers != workers_arg) {
+		delete[] queues;
+		workers = workers_arg;
+		queues = new Queue[workers];
+	}
+	const int tiles = (int) costs.size();
+	order.resize(tiles);
+	for (int i = 0; i < tiles; ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&] (int a, int b) {
+		return costs[a] > costs[b] || (costs[a] == costs[b] && a < b);
+	});
+
+	load.assign(workers, 0);
+	for (int w = 0; w < workers; ++w)
+		queues[w].tiles.clear();
+	for (int i = 0; i < tiles; ++i) {
+		int tile = order[i];
+		int lightest = std::min_element(load.begin(), load.end()) -
+			load.begin();
+		queues[lightest].tiles.push_back(tile);
+		load[lightest] += costs[tile];
+	}
+	for (int w = 0; w < workers; ++w) {
+		queues[w].front = 0;
+		queues[w].back = (int) queues[w].tiles.size();
+	}
+	steals = 0;
+}
+
+int TileScheduler::next(int worker)
+{
+	{
+		Queue &own = queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (own.front < own.back)
+			return own.tiles[own.front++];
+	}
+	for (int i = 1; i < workers; ++i) {
+		Queue &victim = queues[(worker + i) % workers];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.front < victim.back) {
+			++steals;
+			return victim.tiles[--victim.back];
+		}
+	}
+	return -1;
+}
+
+int TileScheduler::get_steals() const
+{
+	return steals;
+}
@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "topology.h"
+
+const Topology &Topology::Instance()
+{
+	static Topology theSingleInstance;
+	return theSingleInstance;
+}
+
+/* adds CPUs of list like "0-3,8-11" to @cpus */
+static void parse_cpu_list(const char *list, std::vector<int> &cpus)
+{
+	while (*list != '\0' && *list != '\n') {
+		int first, last, length;
+		if (sscanf(list, "%d%n", &first, &length) != 1)
+			return;
+		list += length;
+		last = first;
+		if (*list == '-') {
+			if (sscanf(list + 1, "%d%n", &last, &length) != 1)
+				return;
+			list += 1 + length;
+		}
+		for (int cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+		if (*list == ',')
+			++list;
+	}
+}
+
+Topology::Topology()
+{
+	long configured = sysconf(_SC_NPROCESSORS_CONF);
+	node_of.assign(configured > 0 ? configured : 1, 0);
+	for (int node = 0; ; ++node) {
+		char name[64];
+		snprintf(name, sizeof(name),
+			"/sys/devices/system/node/node%d/cpulist", node);
+		FILE *in = fopen(name, "rt");
+		if (in == NULL)
+			break;
+		char list[4096] = "";
+		if (fgets(list, sizeof(list), in) == NULL)
+			list[0] = '\0';
+		fclose(in);
+		std::vector<int> cpus;
+		parse_cpu_list(list, cpus);
+		/* memory-only nodes have no CPUs */
+		if (cpus.empty())
+			continue;
+		for (size_t i = 0; i < cpus.size(); ++i) {
+			if (cpus[i] >= (int) node_of.size())
+				node_of.resize(cpus[i] + 1, 0);
+			node_of[cpus[i]] = (int) node_cpus.size();
+		}
+		node_cpus.push_back(cpus);
+	}
+	if (node_cpus.empty()) {
+		node_cpus.resize(1);
+		for (int cpu = 0; cpu < (int) node_of.size(); ++cpu)
+			node_cpus[0].push_back(cpu);
+	}
+	usable_cpus = node_of.size();
+	/* only CPUs of the process' cpuset (Slurm, containers) */
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return;
+	std::vector<std::vector<int> > usable;
+	for (size_t n = 0; n < node_cpus.size(); ++n) {
+		std::vector<int> cpus;
+		for (size_t i = 0; i < node_cpus[n].size(); ++i)
+			if (node_cpus[n][i] < CPU_SETSIZE &&
+					CPU_ISSET(node_cpus[n][i], &allowed))
+				cpus.push_back(node_cpus[n][i]);
+		if (!cpus.empty())
+			usable.push_back(cpus);
+	}
+	if (usable.empty())
+		return;
+	node_cpus.swap(usable);
+	usable_cpus = 0;
+	std::fill(node_of.begin(), node_of.end(), 0);
+	for (size_t n = 0; n < node_cpus.size(); ++n) {
+		for (size_t i = 0; i < node_cpus[n].size(); ++i)
+			node_of[node_cpus[n][i]] = n;
+		usable_cpus += node_cpus[n].size();
+	}
+}
+
+int Topology::node(int cpu) const
+{
+	return cpu >= 0 && cpu < (int) node_of.size() ? node_of[cpu] : 0;
+}
+
+int Topology::current_node() const
+{
+	return node(sched_getcpu());
+}
+
+bool Topology::placement(const char *policy, int threads,
+	std::vector<int> &cpus) const
+{
+	std::vector<int> order;
+	if (strcmp(policy, "compact") == 0) {
+		for (size_t n = 0; n < node_cpus.size(); ++n)
+			order.insert(order.end(), node_cpus[n].begin(),
+				node_cpus[n].end());
+	} else if (strcmp(policy, "scatter") == 0) {
+		for (size_t k = 0; ; ++k) {
+			size_t before = order.size();
+			for (size_t n = 0; n < node_cpus.size(); ++n)
+				if (k < node_cpus[n].size())
+					order.push_back(node_cpus[n][k]);
+			if (order.size() == before)
+				break;
+		}
+	} else {
+		return false;
+	}
+	cpus.resize(threads);
+	for (int t = 0; t < threads; ++t)
+		cpus[t] = order[t % order.size()];
+	return true;
+}
+
+void release_pages(void *data, size_t bytes, bool huge_pages)
+{
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t begin = ((uintptr_t) data + page - 1) / page * page;
+	uintptr_t end = ((uintptr_t) data + bytes) / page * page;
+	if (end <= begin)
+		return;
+#ifdef MADV_HUGEPAGE
+	if (huge_pages)
+		madvise((void *) begin, end - begin, MADV_HUGEPAGE);
+#endif
+	madvise((void *) begin, end - begin, MADV_DONTNEED);
+}
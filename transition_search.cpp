@@ -0,0 +1,62 @@
+#include <cmath>
+#include <algorithm>
+#include "transition_search.h"
+
+TransitionSearch::TransitionSearch(const std::vector<ld> &coarse,
+	bool geometric, ld resolution, int max_points) :
+	coarse(coarse), coarse_next(0), geometric(geometric),
+	resolution(resolution), max_points(max_points)
+{
+}
+
+int TransitionSearch::steepest() const
+{
+	int best = -1;
+	ld best_change = -1;
+	for (size_t i = 0; i + 1 < measured.size(); ++i) {
+		ld change = fabs(measured[i + 1].second - measured[i].second);
+		if (change > best_change) {
+			best_change = change;
+			best = (int) i;
+		}
+	}
+	return best;
+}
+
+bool TransitionSearch::next(ld &D_phi)
+{
+	if (coarse_next < coarse.size()) {
+		D_phi = coarse[coarse_next++];
+		return true;
+	}
+	if (resolution <= 0 || (int) measured.size() >= max_points)
+		return false;
+	int i = steepest();
+	if (i < 0)
+		return false;
+	ld left = measured[i].first;
+	ld right = measured[i + 1].first;
+	if (right - left <= resolution)
+		return false;
+	D_phi = geometric && left > 0 ? sqrt(left * right) :
+		(left + right) / 2;
+	return true;
+}
+
+void TransitionSearch::record(ld D_phi, ld order)
+{
+	std::pair<ld, ld> point(D_phi, order);
+	measured.insert(std::upper_bound(measured.begin(), measured.end(),
+		point), point);
+}
+
+void TransitionSearch::report(FILE *out) const
+{
+	int i = steepest();
+	if (i < 0)
+		return;
+	fprintf(out, "%d points measured, the order parameter changes most "
+		"(%lf -> %lf) for D_phi in [%lf, %lf]\n", (int) measured.size(),
+		measured[i].second, measured[i + 1].second,
+		measured[i].first, measured[i + 1].first);
+}